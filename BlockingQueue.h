@@ -0,0 +1,109 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef BLOCKINGQUEUE_H
+#define BLOCKINGQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+#include <utility>
+
+/*
+===========================================================
+
+    BlockingQueue
+
+    Hands items over from producer threads to consumer threads.
+    push() waits while the queue is full, so a fast producer can't
+    run ahead of its consumers, and fails once the queue has been
+    closed. pop() waits for an item and fails once the queue has
+    been closed and drained. tryPop() takes an item only if one
+    is already waiting.
+
+===========================================================
+*/
+template <typename T>
+class BlockingQueue
+{
+public:
+
+    explicit BlockingQueue(int capacity) : capacity(capacity) {}
+
+    bool push(T item)
+    {
+        QMutexLocker locker(&mutex);
+
+        while (items.size() >= capacity && !closed)
+            notFull.wait(&mutex);
+
+        if (closed)
+            return false;
+
+        items.enqueue(std::move(item));
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        QMutexLocker locker(&mutex);
+
+        while (items.isEmpty() && !closed)
+            notEmpty.wait(&mutex);
+
+        if (items.isEmpty())
+            return false;
+
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    bool tryPop(T &item)
+    {
+        QMutexLocker locker(&mutex);
+
+        if (items.isEmpty())
+            return false;
+
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QQueue<T> items;
+    const int capacity;
+    bool closed = false;
+};
+
+#endif // BLOCKINGQUEUE_H
@@ -13,16 +13,20 @@ CONFIG += c++20
 TARGET = CodeMetrics
 TEMPLATE = app
 
+include(Core.pri)
+
 SOURCES +=\
     DirsFirstProxyModel.cpp \
     FileSelectorModel.cpp \
         MainWindow.cpp \
     Main.cpp \
+    PathSelection.cpp \
     ProjectsList.cpp
 
 HEADERS  += MainWindow.h \
     DirsFirstProxyModel.h \
     FileSelectorModel.h \
+    PathSelection.h \
     ProjectsList.h
 
 FORMS    += MainWindow.ui
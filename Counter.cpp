@@ -0,0 +1,896 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+#include "Counter.h"
+#include "BlockingQueue.h"
+#include "DirectoryWalker.h"
+#include "GitRepository.h"
+#include "LineClassifier.h"
+#include "Hash.h"
+#include "Profiler.h"
+#include "UringReader.h"
+
+// Bounds of the queues between the stages of counting
+#define FILES_QUEUE_SIZE    4096
+#define READ_QUEUE_SIZE     4   // Per classifying thread
+#define RESULTS_QUEUE_SIZE  1024
+
+// Files up to this size are read whole before they're classified
+#define READ_SIZE_LIMIT     (1 << 20)
+
+// Files read through io_uring have to fit in one of its buffers
+#define URING_BUFFER_SIZE   (64 << 10)
+
+struct PendingFile
+{
+    enum State
+    {
+        Read,       // Text has been read and has to be classified
+        Unread,     // Too big to be read whole, has to be streamed
+        Counted,
+        Copy,       // Has the same contents as a file that's counted instead
+        Failed
+    };
+
+    SourceFile file;
+    State state = Failed;
+    FileCacheEntry entry;
+    QByteArray text;
+};
+
+// A file on disk, or contents, in one language
+struct DuplicateKey
+{
+    quint64 first;      // Device, or size of the contents
+    quint64 second;     // Inode, or hash of the contents
+    int langType;
+
+    bool operator==(const DuplicateKey &other) const { return first == other.first && second == other.second && langType == other.langType; }
+};
+
+inline size_t qHash(const DuplicateKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.first, key.second, key.langType);
+}
+
+struct DuplicateEntry
+{
+    int copies = 0;
+    MetricsData data;
+};
+
+// Files and contents found so far, shared by the stages of counting
+struct DuplicateFiles
+{
+    QMutex mutex;
+    QHash<DuplicateKey, DuplicateEntry> files;
+    QHash<DuplicateKey, DuplicateEntry> contents;
+};
+
+/*
+===================
+fileKey
+===================
+*/
+static DuplicateKey fileKey(const SourceFile &file)
+{
+    return DuplicateKey{file.device, file.inode, file.langType};
+}
+
+/*
+===================
+contentKey
+===================
+*/
+static DuplicateKey contentKey(const PendingFile &pending)
+{
+    return DuplicateKey{quint64(pending.entry.size), pending.entry.hash, pending.file.langType};
+}
+
+/*
+===================
+Counter::Counter
+===================
+*/
+Counter::Counter(QObject *parent) : QObject(parent)
+{
+}
+
+/*
+===================
+Counter::~Counter
+===================
+*/
+Counter::~Counter()
+{
+    stop();
+    wait();
+}
+
+/*
+===================
+Counter::start
+===================
+*/
+void Counter::start(const QStringList &pathList)
+{
+    if (isRunning())
+        return;
+
+    wait();
+
+    repository = nullptr;
+    tree.clear();
+    blobMetrics.clear();
+    startThread(pathList);
+}
+
+/*
+===================
+Counter::start
+
+Counts the files of a tree of a git repository, reading them from its
+object database. The repository has to outlive counting. Metrics of
+blobs are kept for the next tree of the same repository, so counting
+many revisions classifies each distinct blob only once.
+===================
+*/
+void Counter::start(const GitRepository *gitRepository, const QByteArray &treeId)
+{
+    if (isRunning())
+        return;
+
+    wait();
+
+    if (gitRepository != repository)
+        blobMetrics.clear();
+
+    repository = gitRepository;
+    tree = treeId;
+    startThread(QStringList());
+}
+
+/*
+===================
+Counter::startThread
+===================
+*/
+void Counter::startThread(const QStringList &pathList)
+{
+    stopped = false;
+    filesCounted = 0;
+    filesFound = 0;
+    lastPercent = -1;
+    memset(&metrics, 0, sizeof(MetricsData) * Language::TypeCount);
+    groupMetrics.fill(GroupMetrics());
+
+    thread = QThread::create([this, pathList](){ run(pathList); });
+    thread->start();
+}
+
+/*
+===================
+Counter::setGroups
+
+Every file found under the paths of a group is also added up for that
+group, and a file may be in many groups. Paths are matched as they're
+given, so they should be given the same way as the paths to count.
+Only applies to counts of paths, and is kept until it's set again.
+===================
+*/
+void Counter::setGroups(const QList<QStringList> &pathLists)
+{
+    groupPaths.clear();
+    groupMetrics.resize(pathLists.size());
+
+    for (int i = 0; i < pathLists.size(); i++)
+    {
+        for (auto &path : pathLists[i])
+        {
+            QList<int> &groups = groupPaths[QDir::cleanPath(path)];
+
+            if (!groups.contains(i))
+                groups.append(i);
+        }
+    }
+}
+
+/*
+===================
+Counter::splitGroups
+
+Splits groups into sets that can be counted together and returns the
+indexes of the groups of every set. Ignore patterns apply from the paths
+they're counted from, and a path inside another one is only walked from
+the outer one, so a group with a path inside a path of another group
+goes into another set, where it's walked from its own paths like when
+it's counted alone.
+===================
+*/
+QList<QList<int>> Counter::splitGroups(const QList<QStringList> &pathLists)
+{
+    QList<QStringList> absolutePathLists;
+
+    for (auto &pathList : pathLists)
+    {
+        QStringList absolutePaths;
+
+        for (auto &path : pathList)
+            absolutePaths.append(QDir::cleanPath(QFileInfo(path).absoluteFilePath()));
+
+        absolutePathLists.append(absolutePaths);
+    }
+
+    auto isNested = [&absolutePathLists](int first, int second)
+    {
+        for (auto &path : absolutePathLists[first])
+        {
+            for (auto &other : absolutePathLists[second])
+            {
+                if (path != other && (path.startsWith(other.endsWith('/') ? other : other + '/') ||
+                                      other.startsWith(path.endsWith('/') ? path : path + '/')))
+                    return true;
+            }
+        }
+
+        return false;
+    };
+
+    QList<QList<int>> sets;
+
+    for (int i = 0; i < absolutePathLists.size(); i++)
+    {
+        qsizetype set = 0;
+
+        while (set < sets.size() && std::any_of(sets[set].begin(), sets[set].end(), [&isNested, i](int group){ return isNested(i, group); }))
+            set++;
+
+        if (set == sets.size())
+            sets.append(QList<int>());
+
+        sets[set].append(i);
+    }
+
+    return sets;
+}
+
+/*
+===================
+Counter::stop
+===================
+*/
+void Counter::stop()
+{
+    stopped = true;
+}
+
+/*
+===================
+Counter::wait
+===================
+*/
+void Counter::wait()
+{
+    if (!thread)
+        return;
+
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+}
+
+/*
+===================
+Counter::isRunning
+===================
+*/
+bool Counter::isRunning() const
+{
+    return thread && thread->isRunning();
+}
+
+/*
+===================
+Counter::getMetrics
+===================
+*/
+void Counter::getMetrics(MetricsData *data) const
+{
+    QMutexLocker locker(&mutex);
+    memcpy(data, metrics, sizeof(MetricsData) * Language::TypeCount);
+}
+
+/*
+===================
+Counter::getGroupMetrics
+===================
+*/
+void Counter::getGroupMetrics(int group, MetricsData *data) const
+{
+    QMutexLocker locker(&mutex);
+    memcpy(data, groupMetrics[group].data, sizeof(MetricsData) * Language::TypeCount);
+}
+
+/*
+===================
+Counter::run
+
+Files go through four stages connected by bounded queues: the directory
+walk, reading, classifying and adding up the results on this thread.
+Counting starts as soon as the first file is found, and no stage can get
+more than a queue ahead of the next one, so memory use doesn't depend
+on the size of the tree. Files reached more than once, through hard
+links or overlapping paths, are only passed on the first time.
+===================
+*/
+void Counter::run(const QStringList &pathList)
+{
+    int threadCount = qMax(QThread::idealThreadCount(), 1);
+    bool useUring = uringDepth > 0 && !repository && UringReader::isSupported();
+
+    // A ring keeps many files in flight, so fewer threads are needed to read them
+    int readerCount = useUring ? qMax(threadCount / 4, 1) : threadCount;
+    DuplicateFiles duplicateFiles;
+    duplicates = &duplicateFiles;
+
+    BlockingQueue<SourceFile> filesQueue(FILES_QUEUE_SIZE);
+    BlockingQueue<PendingFile> readQueue(threadCount * READ_QUEUE_SIZE);
+    BlockingQueue<PendingFile> resultsQueue(RESULTS_QUEUE_SIZE);
+    std::atomic<int> readers = readerCount;
+    std::atomic<int> classifiers = threadCount;
+
+    // Every stage runs at the same time, or a full queue would never drain
+    QThreadPool pool;
+    pool.setMaxThreadCount(1 + readerCount + threadCount);
+
+    emit progress(0, 0);
+
+    // Lists files
+    pool.start([this, &pathList, &filesQueue, &duplicateFiles]()
+    {
+        auto found = [this, &filesQueue, &duplicateFiles](const SourceFile &file)
+        {
+            if (file.inode && findsCopies())
+            {
+                QMutexLocker locker(&duplicateFiles.mutex);
+
+                // Copies get the metrics of the first one once counting is done
+                if (duplicateFiles.files[fileKey(file)].copies++)
+                {
+                    locker.unlock();
+
+                    if (duplicateMode == CountEveryCopy)
+                    {
+                        QMutexLocker metricsLocker(&mutex);
+                        metrics[file.langType].sourceFiles++;
+                    }
+
+                    return;
+                }
+            }
+
+            filesFound++;
+
+            QList<int> groups = findGroups(file.filename);
+
+            {
+                QMutexLocker locker(&mutex);
+                metrics[file.langType].sourceFiles++;
+
+                for (int group : groups)
+                    groupMetrics[group].data[file.langType].sourceFiles++;
+            }
+
+            filesQueue.push(file);
+        };
+
+        if (repository)
+        {
+            PROFILE_SCOPE("List");
+            repository->walkTree(tree, [&found](const QString &path, const QByteArray &id)
+            {
+                Language::Type langType = getFileLanguageType(path.mid(path.lastIndexOf('/') + 1));
+
+                if (langType != Language::None)
+                    found(SourceFile{path, langType, 0, 0, id});
+            }, stopped, ignorePatterns, ignoreFiles);
+        }
+        else
+        {
+            DirectoryWalker walker(stopped);
+            walker.setIgnorePatterns(ignorePatterns);
+            walker.setIgnoreFiles(ignoreFiles);
+            walker.walk(pathList, found);
+        }
+
+        filesQueue.close();
+    });
+
+    // Reads files
+    for (int i = 0; i < readerCount; i++)
+    {
+        pool.start([this, useUring, &filesQueue, &readQueue, &resultsQueue, &readers]()
+        {
+            auto pass = [&readQueue, &resultsQueue](PendingFile &pending)
+            {
+                if (pending.state == PendingFile::Read || pending.state == PendingFile::Unread)
+                    readQueue.push(std::move(pending));
+                else
+                    resultsQueue.push(std::move(pending));
+            };
+
+            // Whatever is left when the ring stops working is read the usual way
+            if (useUring)
+                readFilesAsync(filesQueue, pass);
+
+            SourceFile file;
+
+            while (!stopped && filesQueue.pop(file))
+            {
+                PendingFile pending{file};
+                readFile(pending);
+                pass(pending);
+            }
+
+            // Wakes up the stages waiting on each other, so they can see that counting has been stopped
+            if (stopped)
+            {
+                filesQueue.close();
+                resultsQueue.close();
+            }
+
+            if (!--readers)
+                readQueue.close();
+        });
+    }
+
+    // Classifies lines
+    for (int i = 0; i < threadCount; i++)
+    {
+        pool.start([this, &readQueue, &resultsQueue, &classifiers]()
+        {
+            PendingFile pending;
+
+            while (!stopped && readQueue.pop(pending))
+            {
+                classifyFile(pending);
+                resultsQueue.push(std::move(pending));
+            }
+
+            if (stopped)
+                readQueue.close();
+
+            if (!--classifiers)
+                resultsQueue.close();
+        });
+    }
+
+    // Adds up the results
+    FileCache cacheEntries;
+    QList<PendingFile> copies;
+    PendingFile pending;
+
+    while (!stopped && resultsQueue.pop(pending))
+    {
+        if (pending.state == PendingFile::Counted)
+        {
+            QList<int> groups = findGroups(pending.file.filename);
+            QMutexLocker locker(&mutex);
+            metrics[pending.file.langType] += pending.entry.data;
+
+            for (int group : groups)
+                groupMetrics[group].data[pending.file.langType] += pending.entry.data;
+        }
+
+        if (pending.state == PendingFile::Counted && findsCopies() && (pending.file.inode || compareContents))
+        {
+            QMutexLocker locker(&duplicateFiles.mutex);
+
+            if (pending.file.inode)
+                duplicateFiles.files[fileKey(pending.file)].data = pending.entry.data;
+
+            // Only files that claimed their contents have an entry, not ones that were streamed
+            if (compareContents && pending.entry.hashed)
+            {
+                auto it = duplicateFiles.contents.find(contentKey(pending));
+
+                if (it != duplicateFiles.contents.end())
+                    it->data = pending.entry.data;
+            }
+        }
+        else if (pending.state == PendingFile::Copy)
+        {
+            copies.append(pending);
+
+            if (duplicateMode == CountOnce)
+            {
+                QMutexLocker locker(&mutex);
+                metrics[pending.file.langType].sourceFiles--;
+            }
+        }
+
+        if (cache && !repository && pending.state == PendingFile::Counted)
+            cacheEntries.insert(pending.file.filename, pending.entry);
+
+        if (repository && pending.state == PendingFile::Counted)
+        {
+            QMutexLocker locker(&blobMutex);
+            blobMetrics.insert(BlobKey{pending.file.objectId, pending.file.langType}, pending.entry.data);
+        }
+
+        int files = ++filesCounted;
+        int total = filesFound;
+        int percent = (float) files / total * 100;
+
+        // Reports only when the percentage changes, so the UI isn't flooded with signals
+        if (lastPercent.exchange(percent) != percent)
+            emit progress(files, total);
+    }
+
+    if (stopped)
+    {
+        filesQueue.close();
+        readQueue.close();
+        resultsQueue.close();
+    }
+
+    pool.waitForDone();
+
+    if (!stopped)
+        addCopies(copies);
+
+    duplicates = nullptr;
+
+    emit progress(filesCounted, filesFound);
+
+    // Files that weren't reached are kept in the cache when counting has been stopped
+    if (cache && !repository)
+        cache->update(cacheEntries, stopped ? QStringList() : pathList);
+
+    emit finished();
+}
+
+/*
+===================
+Counter::readFile
+===================
+*/
+void Counter::readFile(PendingFile &pending) const
+{
+    if (prepareRead(pending))
+        readFromDisk(pending);
+}
+
+/*
+===================
+Counter::prepareRead
+
+Settles files that can be taken from the cache without classifying
+them. Small files have to be read whole, so that the classifying
+threads never wait on the disk, and only then true is returned;
+bigger ones are left to be streamed.
+===================
+*/
+bool Counter::prepareRead(PendingFile &pending) const
+{
+    const SourceFile &file = pending.file;
+
+    // Blobs are always read whole, they have to be inflated anyway
+    if (repository)
+    {
+        if (findBlob(pending))
+            return false;
+
+        PROFILE_SCOPE("Inflate");
+        GitRepository::ObjectType type;
+        pending.state = (repository->readObject(file.objectId, type, pending.text) && type == GitRepository::Blob ? PendingFile::Read : PendingFile::Failed);
+        Profiler::add(Profiler::Bytes, pending.text.size());
+        return false;
+    }
+
+    const FileCacheEntry *cached = cache ? cache->find(file.filename) : nullptr;
+
+    pending.entry.size = file.size;
+    pending.entry.lastModified = file.lastModified;
+
+    // Unchanged files aren't read at all
+    if (cached && cached->size == file.size && cached->lastModified == file.lastModified)
+    {
+        pending.entry = *cached;
+        pending.state = (compareContents && findsCopies() && pending.entry.hashed && !claimContents(pending) ? PendingFile::Copy : PendingFile::Counted);
+        return false;
+    }
+
+    if (file.size > READ_SIZE_LIMIT)
+    {
+        pending.state = PendingFile::Unread;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+===================
+Counter::readFromDisk
+===================
+*/
+void Counter::readFromDisk(PendingFile &pending) const
+{
+    QFile sourceFile(pending.file.filename);
+
+    {
+        PROFILE_SCOPE("Open");
+
+        if (!sourceFile.open(QIODevice::ReadOnly))
+        {
+            pending.state = PendingFile::Failed;
+            return;
+        }
+    }
+
+    {
+        PROFILE_SCOPE("Read");
+        pending.text = sourceFile.readAll();
+        pending.state = PendingFile::Read;
+    }
+
+    Profiler::add(Profiler::Bytes, pending.text.size());
+    checkContents(pending);
+}
+
+/*
+===================
+Counter::checkContents
+
+Hashes the text of a file that has just been read, when the cache or
+the search for copies needs it.
+===================
+*/
+void Counter::checkContents(PendingFile &pending) const
+{
+    bool comparing = (compareContents && findsCopies());
+
+    if ((cache && cache->isHashing()) || comparing)
+    {
+        PROFILE_SCOPE("Hash");
+        pending.entry.hash = xxHash64(pending.text.constData(), pending.text.size());
+        pending.entry.hashed = true;
+
+        const FileCacheEntry *cached = cache ? cache->find(pending.file.filename) : nullptr;
+
+        // Files that were only touched keep their metrics
+        if (cache && cache->isHashing() && cached && cached->hashed && cached->size == pending.file.size && cached->hash == pending.entry.hash)
+        {
+            pending.entry.data = cached->data;
+            pending.text.clear();
+            pending.state = PendingFile::Counted;
+        }
+    }
+
+    if (comparing && !claimContents(pending))
+    {
+        pending.text.clear();
+        pending.state = PendingFile::Copy;
+    }
+}
+
+/*
+===================
+Counter::readFilesAsync
+
+Reads files through io_uring for as long as the ring works, keeping up
+to a queue depth of them in flight. Files too big for a buffer of the
+ring, and files the ring failed on, are read the usual way instead.
+===================
+*/
+void Counter::readFilesAsync(BlockingQueue<SourceFile> &filesQueue, const std::function<void(PendingFile &)> &pass) const
+{
+    UringReader reader(uringDepth, URING_BUFFER_SIZE);
+    QHash<quint64, PendingFile> reading;
+    quint64 nextTag = 0;
+    SourceFile file;
+
+    auto done = [this, &reading, &pass](quint64 tag, const char *data, qint64 size, bool ok)
+    {
+        PendingFile pending = reading.take(tag);
+
+        if (ok)
+        {
+            pending.text = QByteArray(data, size);
+            pending.state = PendingFile::Read;
+            Profiler::add(Profiler::Bytes, size);
+            checkContents(pending);
+        }
+        else
+        {
+            readFromDisk(pending);
+        }
+
+        pass(pending);
+    };
+
+    while (!stopped && reader.isValid())
+    {
+        // Keeps the ring busy, but only waits for files when nothing is in flight
+        while (reader.hasFreeSlot() && (reader.inFlight() ? filesQueue.tryPop(file) : filesQueue.pop(file)))
+        {
+            PendingFile pending{file};
+
+            if (!prepareRead(pending))
+            {
+                pass(pending);
+            }
+            else if (file.size >= reader.getBufferSize())
+            {
+                readFromDisk(pending);
+                pass(pending);
+            }
+            else
+            {
+                reading.insert(nextTag, pending);
+                reader.add(QFile::encodeName(file.filename), nextTag++);
+            }
+        }
+
+        if (!reader.inFlight())
+            break;
+
+        reader.submitAndWait(done);
+    }
+}
+
+/*
+===================
+Counter::claimContents
+
+Returns false when another file with the same contents has been read
+already, in which case this one is a copy of it.
+===================
+*/
+bool Counter::claimContents(const PendingFile &pending) const
+{
+    QMutexLocker locker(&duplicates->mutex);
+    return !duplicates->contents[contentKey(pending)].copies++;
+}
+
+/*
+===================
+Counter::addCopies
+
+Adds the metrics of copies, which are only known once the files they
+are copies of have been counted. Hard links of a copy of some contents
+count as copies of those contents too.
+===================
+*/
+void Counter::addCopies(const QList<PendingFile> &copies)
+{
+    QMutexLocker locker(&duplicates->mutex);
+    QMutexLocker metricsLocker(&mutex);
+
+    for (auto &copy : copies)
+    {
+        MetricsData data = duplicates->contents.value(contentKey(copy)).data;
+
+        if (copy.file.inode)
+            duplicates->files[fileKey(copy.file)].data = data;
+
+        if (duplicateMode == CountEveryCopy)
+            metrics[copy.file.langType] += data;
+    }
+
+    if (duplicateMode != CountEveryCopy)
+        return;
+
+    for (auto it = duplicates->files.cbegin(); it != duplicates->files.cend(); ++it)
+        for (int i = 1; i < it->copies; i++)
+            metrics[it.key().langType] += it->data;
+}
+
+/*
+===================
+Counter::findGroups
+
+Looks up the path and each of its parent directories among the paths of the groups.
+===================
+*/
+QList<int> Counter::findGroups(const QString &path) const
+{
+    QList<int> groups;
+
+    if (groupPaths.isEmpty() || repository)
+        return groups;
+
+    for (qsizetype end = path.size(); end > 0; end = path.lastIndexOf('/', end - 1))
+    {
+        auto it = groupPaths.constFind(path.left(end));
+
+        if (it == groupPaths.cend())
+            continue;
+
+        for (int group : *it)
+        {
+            if (!groups.contains(group))
+                groups.append(group);
+        }
+    }
+
+    return groups;
+}
+
+/*
+===================
+Counter::findBlob
+
+Settles blobs that have already been counted in the same language, in
+this or an earlier tree.
+===================
+*/
+bool Counter::findBlob(PendingFile &pending) const
+{
+    QMutexLocker locker(&blobMutex);
+    auto it = blobMetrics.constFind(BlobKey{pending.file.objectId, pending.file.langType});
+
+    if (it == blobMetrics.cend())
+        return false;
+
+    pending.entry.data = *it;
+    pending.state = PendingFile::Counted;
+    return true;
+}
+
+/*
+===================
+Counter::classifyFile
+===================
+*/
+void Counter::classifyFile(PendingFile &pending) const
+{
+    PROFILE_SCOPE("Classify");
+    LineClassifier classifier(pending.file.langType);
+
+    // Files too big to be read whole are read while they're classified
+    if (pending.state == PendingFile::Unread)
+        Profiler::add(Profiler::Bytes, pending.file.size);
+
+    if (pending.state == PendingFile::Read)
+    {
+        classifier.count(pending.text.constData(), pending.text.size(), pending.entry.data);
+        pending.text.clear();
+        pending.state = PendingFile::Counted;
+    }
+    else if (cache && cache->isHashing())
+    {
+        pending.state = (cache->countHashed(pending.file.filename, pending.file.langType, pending.entry) ? PendingFile::Counted : PendingFile::Failed);
+    }
+    else
+    {
+        pending.state = (classifier.countFile(pending.file.filename, pending.entry.data) ? PendingFile::Counted : PendingFile::Failed);
+    }
+
+    Profiler::add(Profiler::Files, 1);
+    Profiler::add(Profiler::Lines, pending.entry.data.lines);
+}
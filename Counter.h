@@ -0,0 +1,158 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+#include "FileCache.h"
+
+class QThread;
+class GitRepository;
+struct PendingFile;
+template <typename T> class BlockingQueue;
+struct DuplicateFiles;
+
+// A blob is classified by the language of the path it's found under
+struct BlobKey
+{
+    QByteArray objectId;
+    int langType;
+
+    bool operator==(const BlobKey &other) const { return objectId == other.objectId && langType == other.langType; }
+};
+
+inline size_t qHash(const BlobKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.objectId, key.langType);
+}
+
+/*
+===========================================================
+
+    Counter
+
+    Counts source files on a separate thread. The directory walk,
+    reading and classifying run on a pool of threads at the same
+    time, passing files along through bounded queues, and results
+    are added up as soon as each file has been counted. Files
+    can also be added up for groups of paths that overlap, such
+    as several projects counted in one go.
+
+===========================================================
+*/
+class Counter : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    // How copies of a file are counted, they're read only once either way
+    enum DuplicateMode
+    {
+        CountEveryCopy,
+        CountOnce
+    };
+
+    explicit Counter(QObject *parent = nullptr);
+    ~Counter();
+
+    void start(const QStringList &pathList);
+    void start(const GitRepository *gitRepository, const QByteArray &treeId);
+    void stop();
+    void wait();
+
+    void setCache(FileCache *fileCache) { cache = fileCache; }
+    void setDuplicates(DuplicateMode mode, bool byContents) { duplicateMode = mode; compareContents = byContents; }
+    void setIgnore(const QStringList &patternList, bool useIgnoreFiles) { ignorePatterns = patternList; ignoreFiles = useIgnoreFiles; }
+    void setUringDepth(int depth) { uringDepth = depth; }
+    void setGroups(const QList<QStringList> &pathLists);
+
+    static QList<QList<int>> splitGroups(const QList<QStringList> &pathLists);
+
+    bool isRunning() const;
+    bool isStopped() const { return stopped; }
+    bool isComparingContents() const { return compareContents; }
+    DuplicateMode getDuplicateMode() const { return duplicateMode; }
+    int getUringDepth() const { return uringDepth; }
+    void getMetrics(MetricsData *data) const;
+    void getGroupMetrics(int group, MetricsData *data) const;
+    void getProgress(int &files, int &total) const { files = filesCounted; total = filesFound; }
+
+Q_SIGNALS:
+
+    void progress(int files, int total);
+    void finished();
+
+private:
+
+    void startThread(const QStringList &pathList);
+    void run(const QStringList &pathList);
+    void readFile(PendingFile &pending) const;
+    bool prepareRead(PendingFile &pending) const;
+    void readFromDisk(PendingFile &pending) const;
+    void checkContents(PendingFile &pending) const;
+    void readFilesAsync(BlockingQueue<SourceFile> &filesQueue, const std::function<void(PendingFile &)> &pass) const;
+    void classifyFile(PendingFile &pending) const;
+    bool findBlob(PendingFile &pending) const;
+    bool claimContents(const PendingFile &pending) const;
+    void addCopies(const QList<PendingFile> &copies);
+    QList<int> findGroups(const QString &path) const;
+
+    // Copies can't be told apart by group, so counts of groups take every path on its own
+    bool findsCopies() const { return groupPaths.isEmpty(); }
+
+    QThread *thread = nullptr;
+    FileCache *cache = nullptr;
+    const GitRepository *repository = nullptr;
+    QByteArray tree;
+
+    // Metrics of every blob counted since the repository was last changed, in every language it was found in
+    mutable QMutex blobMutex;
+    QHash<BlobKey, MetricsData> blobMetrics;
+    QStringList ignorePatterns;
+    bool ignoreFiles = false;
+    DuplicateMode duplicateMode = CountEveryCopy;
+    bool compareContents = false;
+    int uringDepth = 0;     // Files kept in flight by each io_uring reader, 0 disables it
+    DuplicateFiles *duplicates = nullptr;
+    std::atomic<bool> stopped = false;
+    std::atomic<int> filesCounted = 0;
+    std::atomic<int> filesFound = 0;
+    std::atomic<int> lastPercent = -1;
+
+    struct GroupMetrics
+    {
+        MetricsData data[Language::TypeCount];
+    };
+
+    // Paths of the groups files are also added up for, with the groups each of them is in
+    QHash<QString, QList<int>> groupPaths;
+
+    mutable QMutex mutex;
+    MetricsData metrics[Language::TypeCount];
+    QList<GroupMetrics> groupMetrics;
+};
+
+#endif // COUNTER_H
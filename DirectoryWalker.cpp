@@ -0,0 +1,447 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#endif
+
+#include "DirectoryWalker.h"
+#include "Profiler.h"
+
+/*
+===================
+DirectoryWalker::walk
+
+Files given directly are passed to the sink right away, directories
+are spread across the queues of the threads that will list them.
+Ignore patterns are relative to the directory they were given for.
+Paths inside other paths of the list are left out, so nothing is
+listed twice. Returns once everything has been listed or the walk has been stopped.
+===================
+*/
+void DirectoryWalker::walk(const QStringList &pathList, const Sink &sink)
+{
+    this->sink = &sink;
+    queueCount = qMax(QThread::idealThreadCount(), 1);
+    queues.reset(new DirectoryQueue[queueCount]);
+    pending = 0;
+
+    int next = 0;
+    QStringList absolutePaths;
+
+    for (auto &path : pathList)
+        absolutePaths.append(QDir::cleanPath(QFileInfo(path).absoluteFilePath()));
+
+    for (int i = 0; i < pathList.size(); i++)
+    {
+        if (isInside(absolutePaths, i))
+            continue;
+
+        QFileInfo fileInfo(pathList[i]);
+
+        if (!fileInfo.exists())
+            continue;
+
+        if (stopped)
+            break;
+
+        if (fileInfo.isFile())
+        {
+            Language::Type langType = getFileLanguageType(fileInfo.fileName());
+
+            if (langType != Language::None)
+                sink(SourceFile{fileInfo.filePath(), langType, fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch()});
+        }
+        else if (fileInfo.isDir())
+        {
+            std::shared_ptr<IgnoreRules> rules;
+
+            if (!ignorePatterns.isEmpty())
+            {
+                rules = std::make_shared<IgnoreRules>(fileInfo.filePath());
+                rules->addPatterns(ignorePatterns);
+            }
+
+            addDirectory(next++ % queueCount, fileInfo.filePath(), rules);
+        }
+    }
+
+    run();
+    this->sink = nullptr;
+}
+
+/*
+===================
+DirectoryWalker::relist
+
+Lists a directory again with the rules it was listed with the first time,
+before its own ignore files were read. Only subdirectories the directory
+sink lets through are walked.
+===================
+*/
+void DirectoryWalker::relist(const QString &path, const std::shared_ptr<const IgnoreRules> &rules, const Sink &sink)
+{
+    this->sink = &sink;
+    queueCount = qMax(QThread::idealThreadCount(), 1);
+    queues.reset(new DirectoryQueue[queueCount]);
+
+    pending = 1;
+    queues[0].directories.append(PendingDirectory{path, rules});
+
+    run();
+    this->sink = nullptr;
+}
+
+/*
+===================
+DirectoryWalker::run
+===================
+*/
+void DirectoryWalker::run()
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(queueCount);
+
+    for (int i = 0; i < queueCount; i++)
+        pool.start([this, i](){ work(i); });
+
+    pool.waitForDone();
+
+    queues.reset();
+}
+
+/*
+===================
+DirectoryWalker::isInside
+
+Whether a path is inside another path of the list, or the same as an earlier one.
+===================
+*/
+bool DirectoryWalker::isInside(const QStringList &absolutePaths, int index)
+{
+    const QString &path = absolutePaths[index];
+
+    for (int i = 0; i < absolutePaths.size(); i++)
+    {
+        const QString &other = absolutePaths[i];
+
+        if (i == index || (other == path && i > index))
+            continue;
+
+        if (other == path || path.startsWith(other.endsWith('/') ? other : other + '/'))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+===================
+DirectoryWalker::work
+
+A thread that finds nothing to take sleeps until a directory is queued,
+the last pending directory has been listed or the walk has been stopped.
+The queues are checked again under the idle mutex before it sleeps, so a
+directory queued in between isn't missed.
+===================
+*/
+void DirectoryWalker::work(int index)
+{
+    PendingDirectory directory;
+
+    while (!stopped)
+    {
+        if (!takeDirectory(index, directory))
+        {
+            QMutexLocker locker(&idleMutex);
+
+            if (!pending || stopped)
+                break;
+
+            // Other threads are still listing and may find more directories
+            if (!takeDirectory(index, directory))
+            {
+                idleCondition.wait(&idleMutex);
+                continue;
+            }
+        }
+
+        listDirectory(index, directory);
+
+        if (--pending == 0)
+        {
+            QMutexLocker locker(&idleMutex);
+            idleCondition.wakeAll();
+        }
+    }
+
+    // Threads asleep in a stopped walk would otherwise wait for directories nobody lists
+    QMutexLocker locker(&idleMutex);
+    idleCondition.wakeAll();
+}
+
+/*
+===================
+DirectoryWalker::takeDirectory
+
+Takes the most recently found directory of its own queue first, which
+keeps a thread deep in one subtree, and steals the oldest directory of
+another queue otherwise, which is usually the biggest remaining subtree.
+===================
+*/
+bool DirectoryWalker::takeDirectory(int index, PendingDirectory &directory)
+{
+    {
+        QMutexLocker locker(&queues[index].mutex);
+
+        if (!queues[index].directories.isEmpty())
+        {
+            directory = queues[index].directories.takeLast();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < queueCount; i++)
+    {
+        DirectoryQueue &victim = queues[(index + i) % queueCount];
+        QMutexLocker locker(&victim.mutex);
+
+        if (!victim.directories.isEmpty())
+        {
+            directory = victim.directories.takeFirst();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+===================
+DirectoryWalker::addDirectory
+===================
+*/
+void DirectoryWalker::addDirectory(int index, const QString &path, const std::shared_ptr<const IgnoreRules> &rules)
+{
+    if (directorySink && !directorySink(path, rules))
+        return;
+
+    // Counted before it's queued, so an idle thread can't see zero pending directories too early
+    pending++;
+
+    {
+        QMutexLocker locker(&queues[index].mutex);
+        queues[index].directories.append(PendingDirectory{path, rules});
+    }
+
+    QMutexLocker locker(&idleMutex);
+    idleCondition.wakeOne();
+}
+
+/*
+===================
+DirectoryWalker::getEntryRules
+
+Returns the rules the entries of a directory listed with the given
+rules are matched with.
+===================
+*/
+std::shared_ptr<const IgnoreRules> DirectoryWalker::getEntryRules(const QString &path, const std::shared_ptr<const IgnoreRules> &rules) const
+{
+    if (!ignoreFiles)
+        return rules;
+
+    return loadIgnoreFiles(path.endsWith('/') ? path : path + '/', rules);
+}
+
+/*
+===================
+DirectoryWalker::loadIgnoreFiles
+
+Returns the rules of a directory's own ignore files chained to the
+rules of its parents, or just the latter when there's nothing to add.
+===================
+*/
+std::shared_ptr<const IgnoreRules> DirectoryWalker::loadIgnoreFiles(const QString &prefix, const std::shared_ptr<const IgnoreRules> &rules) const
+{
+    auto directoryRules = std::make_shared<IgnoreRules>(prefix, rules);
+    directoryRules->addFile(prefix + ".gitignore");
+    directoryRules->addFile(prefix + ".ignore");
+
+    if (directoryRules->isEmpty())
+        return rules;
+
+    return directoryRules;
+}
+
+#ifdef Q_OS_UNIX
+
+/*
+===================
+DirectoryWalker::listDirectory
+
+Skips the same entries QDirIterator did before: hidden entries,
+symbolic links and anything that isn't a regular file or a directory.
+Entries are read first, so the ignore files are known before any of
+them is matched.
+===================
+*/
+void DirectoryWalker::listDirectory(int index, const PendingDirectory &directory)
+{
+    PROFILE_SCOPE("List");
+    DIR *dir = opendir(QFile::encodeName(directory.path).constData());
+
+    if (!dir)
+        return;
+
+    struct Entry
+    {
+        QByteArray name;
+        unsigned char type;
+    };
+
+    QList<Entry> entries;
+    bool hasIgnoreFiles = false;
+
+    while (!stopped)
+    {
+        const dirent *entry = readdir(dir);
+
+        if (!entry)
+            break;
+
+        // Also skips "." and ".."
+        if (entry->d_name[0] == '.')
+        {
+            if (ignoreFiles && (!strcmp(entry->d_name, ".gitignore") || !strcmp(entry->d_name, ".ignore")))
+                hasIgnoreFiles = true;
+
+            continue;
+        }
+
+        entries.append(Entry{QByteArray(entry->d_name), entry->d_type});
+    }
+
+    int fd = dirfd(dir);
+    QString prefix = (directory.path.endsWith('/') ? directory.path : directory.path + '/');
+    std::shared_ptr<const IgnoreRules> rules = (hasIgnoreFiles ? loadIgnoreFiles(prefix, directory.rules) : directory.rules);
+
+    for (auto &entry : entries)
+    {
+        if (stopped)
+            break;
+
+        struct stat status;
+        bool statted = false;
+        unsigned char type = entry.type;
+
+        // Some file systems don't report the type
+        if (type == DT_UNKNOWN)
+        {
+            if (fstatat(fd, entry.name.constData(), &status, AT_SYMLINK_NOFOLLOW))
+                continue;
+
+            statted = true;
+            type = (S_ISDIR(status.st_mode) ? DT_DIR : S_ISREG(status.st_mode) ? DT_REG : DT_UNKNOWN);
+        }
+
+        if (type == DT_DIR)
+        {
+            QString name = QFile::decodeName(entry.name);
+
+            if (!rules || !rules->isIgnored(prefix + name, name, true))
+                addDirectory(index, prefix + name, rules);
+
+            continue;
+        }
+
+        if (type != DT_REG)
+            continue;
+
+        QString filename = QFile::decodeName(entry.name);
+        Language::Type langType = getFileLanguageType(filename);
+
+        if (langType == Language::None)
+            continue;
+
+        if (rules && rules->isIgnored(prefix + filename, filename, false))
+            continue;
+
+        if (!statted && fstatat(fd, entry.name.constData(), &status, AT_SYMLINK_NOFOLLOW))
+            continue;
+
+#ifdef Q_OS_DARWIN
+        const timespec &modified = status.st_mtimespec;
+#else
+        const timespec &modified = status.st_mtim;
+#endif
+
+        qint64 lastModified = static_cast<qint64>(modified.tv_sec) * 1000 + modified.tv_nsec / 1000000;
+        (*sink)(SourceFile{prefix + filename, langType, static_cast<qint64>(status.st_size), lastModified, QByteArray(),
+                           static_cast<quint64>(status.st_dev), static_cast<quint64>(status.st_ino)});
+    }
+
+    closedir(dir);
+}
+
+#else
+
+/*
+===================
+DirectoryWalker::listDirectory
+===================
+*/
+void DirectoryWalker::listDirectory(int index, const PendingDirectory &directory)
+{
+    PROFILE_SCOPE("List");
+    QString prefix = (directory.path.endsWith('/') ? directory.path : directory.path + '/');
+    std::shared_ptr<const IgnoreRules> rules = (ignoreFiles ? loadIgnoreFiles(prefix, directory.rules) : directory.rules);
+    QDirIterator sourceDirectory(directory.path, QDir::Dirs | QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot);
+
+    while (sourceDirectory.hasNext() && !stopped)
+    {
+        sourceDirectory.next();
+        QFileInfo fileInfo = sourceDirectory.fileInfo();
+
+        if (fileInfo.isDir())
+        {
+            if (!rules || !rules->isIgnored(fileInfo.filePath(), fileInfo.fileName(), true))
+                addDirectory(index, fileInfo.filePath(), rules);
+        }
+        else if (fileInfo.isFile())
+        {
+            Language::Type langType = getFileLanguageType(fileInfo.fileName());
+
+            if (langType != Language::None && (!rules || !rules->isIgnored(fileInfo.filePath(), fileInfo.fileName(), false)))
+                (*sink)(SourceFile{fileInfo.filePath(), langType, fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch()});
+        }
+    }
+}
+
+#endif
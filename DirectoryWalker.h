@@ -0,0 +1,105 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QMutex>
+#include <QStringList>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "IgnoreRules.h"
+#include "Language.h"
+
+/*
+===========================================================
+
+    DirectoryWalker
+
+    Lists the source files under a set of paths on several threads.
+    Every thread keeps its own queue of directories to list and
+    steals from the others once it runs out. On POSIX systems
+    directories are read with readdir, using the entry type it
+    reports, so only source files are ever stat'ed. Ignored
+    directories are pruned before they're queued, with the rules of
+    .gitignore and .ignore files carried down to their subdirectories.
+    A directory sink sees every directory before it's listed and
+    can prune more of them.
+
+===========================================================
+*/
+class DirectoryWalker
+{
+public:
+
+    typedef std::function<void(const SourceFile &file)> Sink;
+
+    // Sees every directory before it's queued with the rules it's listed with, returns false to skip it
+    typedef std::function<bool(const QString &path, const std::shared_ptr<const IgnoreRules> &rules)> DirectorySink;
+
+    explicit DirectoryWalker(const std::atomic<bool> &stopped) : stopped(stopped) {}
+
+    void setIgnorePatterns(const QStringList &patternList) { ignorePatterns = patternList; }
+    void setIgnoreFiles(bool enabled) { ignoreFiles = enabled; }
+    void setDirectorySink(const DirectorySink &sink) { directorySink = sink; }
+
+    void walk(const QStringList &pathList, const Sink &sink);
+    void relist(const QString &path, const std::shared_ptr<const IgnoreRules> &rules, const Sink &sink);
+    std::shared_ptr<const IgnoreRules> getEntryRules(const QString &path, const std::shared_ptr<const IgnoreRules> &rules) const;
+
+private:
+
+    struct PendingDirectory
+    {
+        QString path;
+        std::shared_ptr<const IgnoreRules> rules;
+    };
+
+    struct DirectoryQueue
+    {
+        QMutex mutex;
+        QList<PendingDirectory> directories;
+    };
+
+    static bool isInside(const QStringList &absolutePaths, int index);
+    void run();
+    void work(int index);
+    bool takeDirectory(int index, PendingDirectory &directory);
+    void addDirectory(int index, const QString &path, const std::shared_ptr<const IgnoreRules> &rules);
+    void listDirectory(int index, const PendingDirectory &directory);
+    std::shared_ptr<const IgnoreRules> loadIgnoreFiles(const QString &prefix, const std::shared_ptr<const IgnoreRules> &rules) const;
+
+    const std::atomic<bool> &stopped;
+    const Sink *sink = nullptr;
+    DirectorySink directorySink;
+
+    QStringList ignorePatterns;
+    bool ignoreFiles = false;
+
+    std::unique_ptr<DirectoryQueue[]> queues;
+    int queueCount = 0;
+    std::atomic<int> pending = 0;
+
+    QMutex idleMutex;
+    QWaitCondition idleCondition;
+};
+
+#endif // DIRECTORYWALKER_H
@@ -0,0 +1,362 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QFile>
+#include <QDataStream>
+
+#include "FileCache.h"
+#include "Hash.h"
+#include "LineClassifier.h"
+
+#define FILECACHE_MAGIC 0x434D4643 // CMFC
+#define FILECACHE_VERSION 2
+
+#define REMOVED_SIZE -1
+#define HASH_BUFFER_SIZE (1 << 20)
+
+/*
+===================
+hashFile
+
+Hashes a file a mapped window at a time, or through a bounded buffer
+when it can't be mapped, so it's never in memory all at once.
+===================
+*/
+static bool hashFile(const QString &filename, quint64 &hash)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = file.size();
+    qint64 offset = 0;
+
+    if (!file.isSequential())
+    {
+        XxHash64 hasher;
+
+        while (offset < size)
+        {
+            qint64 length = qMin(MAP_SIZE_LIMIT, size - offset);
+            uchar *memory = file.map(offset, length);
+
+            if (!memory)
+                break;
+
+            hasher.add(memory, length);
+            file.unmap(memory);
+            offset += length;
+        }
+
+        if (offset == size)
+        {
+            hash = hasher.result();
+            return true;
+        }
+
+        if (!file.seek(0))
+            return false;
+    }
+
+    XxHash64 hasher;
+    QByteArray buffer(HASH_BUFFER_SIZE, Qt::Uninitialized);
+    qint64 bytesRead;
+
+    while ((bytesRead = file.read(buffer.data(), buffer.size())) > 0)
+        hasher.add(buffer.constData(), bytesRead);
+
+    if (bytesRead < 0)
+        return false;
+
+    hash = hasher.result();
+    return true;
+}
+
+/*
+===================
+FileCache::load
+
+Directories come first, each after its parent, so they can be added
+back in order.
+===================
+*/
+bool FileCache::load(const QString &filename)
+{
+    files.clear();
+    entries.clear();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic, version;
+    qint64 directoryCount, count;
+    in >> magic >> version >> directoryCount >> count;
+
+    if (magic != FILECACHE_MAGIC || version != FILECACHE_VERSION || directoryCount < 1 || count < 0)
+        return false;
+
+    QList<quint32> directories(1, FileTable::Root);
+    directories.reserve(directoryCount);
+
+    for (qint64 i = 1; i < directoryCount && in.status() == QDataStream::Ok; i++)
+    {
+        quint32 parent;
+        QByteArray name;
+
+        in >> parent >> name;
+
+        if (parent >= directories.size())
+            in.setStatus(QDataStream::ReadCorruptData);
+        else
+            directories.append(files.addDirectory(directories[parent], name));
+    }
+
+    files.reserve(count);
+    entries.reserve(count);
+
+    for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        quint32 directory;
+        QByteArray name;
+        FileCacheEntry entry;
+
+        in >> directory >> name >> entry.size >> entry.lastModified >> entry.hashed >> entry.hash;
+        in >> entry.data.lines >> entry.data.linesOfCode >> entry.data.commentLines >> entry.data.commentWords >> entry.data.blankLines;
+
+        if (directory >= directories.size())
+        {
+            in.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+
+        int index = files.addFile(directories[directory], name);
+
+        if (index == entries.size())
+            entries.append(entry);
+        else
+            entries[index] = entry;
+    }
+
+    // Drops a truncated or damaged cache entirely
+    if (in.status() != QDataStream::Ok)
+    {
+        files.clear();
+        entries.clear();
+        return false;
+    }
+
+    return true;
+}
+
+/*
+===================
+FileCache::save
+===================
+*/
+bool FileCache::save(const QString &filename) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    qint64 count = 0;
+
+    for (const FileCacheEntry &entry : entries)
+        count += (entry.size != REMOVED_SIZE);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint32(FILECACHE_MAGIC) << quint32(FILECACHE_VERSION) << qint64(files.directoryCount()) << count;
+
+    for (int i = 1; i < files.directoryCount(); i++)
+    {
+        const FileTable::Directory &directory = files.directory(i);
+        out << directory.parent << QByteArray(files.name(directory.name));
+    }
+
+    for (int i = 0; i < entries.size(); i++)
+    {
+        const FileTable::File &cachedFile = files.file(i);
+        const FileCacheEntry &entry = entries[i];
+
+        if (entry.size == REMOVED_SIZE)
+            continue;
+
+        out << cachedFile.directory << QByteArray(files.name(cachedFile.name)) << entry.size << entry.lastModified << entry.hashed << entry.hash;
+        out << entry.data.lines << entry.data.linesOfCode << entry.data.commentLines << entry.data.commentWords << entry.data.blankLines;
+    }
+
+    return out.status() == QDataStream::Ok;
+}
+
+/*
+===================
+FileCache::find
+===================
+*/
+const FileCacheEntry *FileCache::find(const QString &path) const
+{
+    int index = files.find(path);
+    return index >= 0 && entries[index].size != REMOVED_SIZE ? &entries[index] : nullptr;
+}
+
+/*
+===================
+FileCache::countHashed
+
+Hashes a file without reading it whole and keeps the cached metrics when
+it was only touched. Changed files are classified like any other, a window
+at a time and on all cores when they're big. The size of the entry has to
+be set already.
+===================
+*/
+bool FileCache::countHashed(const QString &path, Language::Type langType, FileCacheEntry &entry) const
+{
+    if (!hashFile(path, entry.hash))
+        return false;
+
+    entry.hashed = true;
+    const FileCacheEntry *cached = find(path);
+
+    if (cached && cached->hashed && cached->size == entry.size && cached->hash == entry.hash)
+    {
+        entry.data = cached->data;
+        return true;
+    }
+
+    return LineClassifier(langType).countFile(path, entry.data);
+}
+
+/*
+===================
+FileCache::insert
+===================
+*/
+void FileCache::insert(const QString &path, const FileCacheEntry &entry)
+{
+    int index = files.addFile(path);
+
+    if (index == entries.size())
+        entries.append(entry);
+    else
+        entries[index] = entry;
+}
+
+/*
+===================
+FileCache::remove
+===================
+*/
+void FileCache::remove(const QString &path)
+{
+    int index = files.find(path);
+
+    if (index >= 0)
+        entries[index].size = REMOVED_SIZE;
+}
+
+/*
+===================
+FileCache::filesInside
+
+Returns the files directly inside a directory, or anywhere under it.
+===================
+*/
+QStringList FileCache::filesInside(const QString &directory, bool recursive) const
+{
+    QStringList paths;
+    quint32 id = files.findDirectoryPath(directory);
+
+    if (id == FileTable::NotFound)
+        return paths;
+
+    // Only the directory and what's under it are looked at
+    QList<quint32> pending(1, id);
+
+    while (!pending.isEmpty())
+    {
+        quint32 directory = pending.takeLast();
+
+        for (int index : files.directoryFiles(directory))
+        {
+            if (entries[index].size != REMOVED_SIZE)
+                paths.append(files.filePath(index));
+        }
+
+        if (recursive)
+            pending.append(files.subdirectories(directory));
+    }
+
+    return paths;
+}
+
+/*
+===================
+FileCache::update
+
+Files can't be taken out of a table, so one is built anew from the
+entries that are kept and the new ones.
+===================
+*/
+void FileCache::update(const FileCache &newEntries, const QStringList &pathList)
+{
+    QList<quint32> directories;
+    QList<int> countedFiles;
+
+    for (auto &path : pathList)
+    {
+        quint32 directory = files.findDirectoryPath(path);
+        int index = files.find(path);
+
+        if (directory != FileTable::NotFound)
+            directories.append(directory);
+        else if (index >= 0)
+            countedFiles.append(index);
+    }
+
+    FileCache updated;
+    updated.hashing = hashing;
+    updated.files.reserve(entries.size());
+    updated.entries.reserve(entries.size());
+
+    // Removes files that no longer exist under the counted paths
+    for (int i = 0; i < entries.size(); i++)
+    {
+        bool stale = countedFiles.contains(i);
+
+        for (int j = 0; j < directories.size() && !stale; j++)
+            stale = files.isInside(i, directories[j]);
+
+        // Counted files are replaced by their new entries below
+        if (!stale && entries[i].size != REMOVED_SIZE)
+            updated.insert(files.filePath(i), entries[i]);
+    }
+
+    for (int i = 0; i < newEntries.entries.size(); i++)
+    {
+        if (newEntries.entries[i].size != REMOVED_SIZE)
+            updated.insert(newEntries.files.filePath(i), newEntries.entries[i]);
+    }
+
+    *this = std::move(updated);
+}
@@ -0,0 +1,76 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <QList>
+#include <QStringList>
+#include "FileTable.h"
+#include "Language.h"
+
+struct FileCacheEntry
+{
+    qint64 size = 0;
+    qint64 lastModified = 0;
+    quint64 hash = 0;
+    bool hashed = false;
+    MetricsData data;
+};
+
+/*
+===========================================================
+
+    FileCache
+
+    Per-file metrics from previous runs. A file whose size and
+    modification time haven't changed isn't read again. With
+    hashing enabled, a file that was only touched is read and
+    hashed, but isn't classified again. Paths are kept in a
+    FileTable, entries in an array in the same order.
+
+===========================================================
+*/
+class FileCache
+{
+public:
+
+    bool load(const QString &filename);
+    bool save(const QString &filename) const;
+
+    void setHashing(bool enabled) { hashing = enabled; }
+    bool isHashing() const { return hashing; }
+
+    const FileCacheEntry *find(const QString &path) const;
+    bool countHashed(const QString &path, Language::Type langType, FileCacheEntry &entry) const;
+    void insert(const QString &path, const FileCacheEntry &entry);
+    void remove(const QString &path);
+    void update(const FileCache &newEntries, const QStringList &pathList);
+    QStringList filesInside(const QString &directory, bool recursive) const;
+
+    int size() const { return entries.size(); }
+
+private:
+
+    FileTable files;
+    QList<FileCacheEntry> entries;     // Removed files stay in the table with a negative size
+    bool hashing = false;
+};
+
+#endif // FILECACHE_H
@@ -26,7 +26,6 @@ FileSelectorModel::FileSelectorModel
 */
 FileSelectorModel::FileSelectorModel(QObject *parent) : QFileSystemModel(parent)
 {
-    connect(this, SIGNAL(directoryLoaded(QString)), this, SLOT(updateCheckboxes(QString)));
 }
 
 /*
@@ -37,14 +36,7 @@ FileSelectorModel::data
 QVariant FileSelectorModel::data(const QModelIndex &index, int role) const
 {
     if (role == Qt::CheckStateRole && index.column() == 0)
-    {
-        if (checkedList.contains(index))
-            return Qt::Checked;
-        else if (partiallyCheckedList.contains(index))
-            return Qt::PartiallyChecked;
-        else
-            return Qt::Unchecked;
-    }
+        return selection.checkState(filePath(index));
 
     return QFileSystemModel::data(index, role);
 }
@@ -56,88 +48,17 @@ FileSelectorModel::setData
 */
 bool FileSelectorModel::setData(const QModelIndex &index, const QVariant &value, int role)
 {
-    if (role == Qt::CheckStateRole && index.column() == 0)
+    if (role == Qt::CheckStateRole && index.column() == 0 && index.isValid())
     {
-        QModelIndexList allChildren;
-        getAllChildren(allChildren, index);
-
-        if (value == Qt::Checked)
-        {
-            checkedList.insert(index);
-            partiallyCheckedList.remove(index);
-            emit dataChanged(index, index);
-
-            for (auto &child : allChildren)
-            {
-                checkedList.insert(child);
-                partiallyCheckedList.remove(child);
-            }
-
-            if (!allChildren.isEmpty())
-                emit dataChanged(allChildren[0], allChildren[allChildren.size() - 1]);
-        }
-        else if (value == Qt::Unchecked)
-        {
-            checkedList.remove(index);
-            partiallyCheckedList.remove(index);
-            emit dataChanged(index, index);
-
-            for (auto &child : allChildren)
-            {
-                checkedList.remove(child);
-                partiallyCheckedList.remove(child);
-            }
-
-            if (!allChildren.isEmpty())
-                emit dataChanged(allChildren[0], allChildren[allChildren.size() - 1]);
-        }
-
-        QModelIndex parent = index.parent();
-
-        // Sets the parent checkbox based on child checkbox states
-        while (parent.isValid())
-        {
-            QModelIndexList children;
-            getChildren(children, parent);
-
-            bool hasChecked = false;
-            bool hasPartiallyChecked = false;
-            bool hasUnchecked = false;
-
-            for (auto &child : children)
-            {
-                QVariant childValue = child.data(Qt::CheckStateRole);
-
-                if (childValue == Qt::Checked)
-                    hasChecked = true;
-                else if (childValue == Qt::PartiallyChecked)
-                    hasPartiallyChecked = true;
-                else if (childValue == Qt::Unchecked)
-                    hasUnchecked = true;
-            }
-
-            // Partially checked
-            if ((hasChecked && hasUnchecked) || hasPartiallyChecked || (hasChecked && canFetchMore(parent)))
-            {
-                checkedList.remove(parent);
-                partiallyCheckedList.insert(parent);
-            }
-            // Unchecked
-            else if (!hasChecked && hasUnchecked)
-            {
-                checkedList.remove(parent);
-                partiallyCheckedList.remove(parent);
-            }
-            // Checked
-            else if (hasChecked && !hasUnchecked)
-            {
-                checkedList.insert(parent);
-                partiallyCheckedList.remove(parent);
-            }
-
-            emit dataChanged(parent, parent);
-            parent = parent.parent();
-        }
+        selection.setChecked(filePath(index), value == Qt::Checked);
+
+        // Parent checkboxes
+        for (QModelIndex parent = index; parent.isValid(); parent = parent.parent())
+            emit dataChanged(parent, parent, {Qt::CheckStateRole});
+
+        // A single range for all descendants, which makes views repaint everything visible
+        if (rowCount(index))
+            emit dataChanged(this->index(0, 0, index), this->index(rowCount(index) - 1, columnCount(index) - 1, index), {Qt::CheckStateRole});
     }
 
     return QFileSystemModel::setData(index, value, role);
@@ -160,73 +81,21 @@ FileSelectorModel::setChecked
 */
 void FileSelectorModel::setChecked(const QStringList &pathList)
 {
-    for (int i = 0; i < rowCount(); i++)
-        setData(index(i, 0, QModelIndex()), Qt::Unchecked, Qt::CheckStateRole);
+    selection.clear();
 
     for (auto &path : pathList)
-        setData(index(path), Qt::Checked, Qt::CheckStateRole);
-}
-
-/*
-===================
-FileSelectorModel::getPathList
-===================
-*/
-void FileSelectorModel::getPathList(QStringList &list, const QModelIndex &parent) const
-{
-    for (int i = 0; i < rowCount(parent); i++)
-    {
-        QVariant value = index(i, 0, parent).data(Qt::CheckStateRole);
-
-        if (value == Qt::Checked)
-            list.push_back(filePath(index(i, 0, parent)));
-        else if (value == Qt::PartiallyChecked)
-            getPathList(list, index(i, 0, parent));
-    }
-}
-
-/*
-===================
-FileSelectorModel::updateCheckboxes
-===================
-*/
-void FileSelectorModel::updateCheckboxes(const QString &path)
-{
-    QModelIndex parent = index(path);
-    QModelIndexList children;
-    getChildren(children, parent);
-
-    // Sets child checkboxes checked when parent checkbox is checked
-    if (parent.data(Qt::CheckStateRole) == Qt::Checked && !children.isEmpty())
-    {
-        for (auto &child : children)
-            checkedList.insert(child);
-
-        emit dataChanged(children[0], children[children.size() - 1]);
-    }
-}
+        selection.setChecked(path, true);
 
-/*
-===================
-FileSelectorModel::getChildren
-===================
-*/
-void FileSelectorModel::getChildren(QModelIndexList &list, const QModelIndex &parent) const
-{
-    for (int i = 0; i < rowCount(parent); i++)
-        list.push_back(parent.model()->index(i, 0, parent));
+    if (rowCount())
+        emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1), {Qt::CheckStateRole});
 }
 
 /*
 ===================
-FileSelectorModel::getAllChildren
+FileSelectorModel::getPathList
 ===================
 */
-void FileSelectorModel::getAllChildren(QModelIndexList &list, const QModelIndex &parent) const
+void FileSelectorModel::getPathList(QStringList &pathList) const
 {
-    for (int i = 0; i < rowCount(parent); i++)
-    {
-        list.push_back(parent.model()->index(i, 0, parent));
-        getAllChildren(list, parent.model()->index(i, 0, parent));
-    }
+    selection.getPathList(pathList, filter());
 }
@@ -21,12 +21,17 @@
 #define FILESELECTORMODEL_H
 
 #include <QFileSystemModel>
+#include "PathSelection.h"
 
 /*
 ===========================================================
 
     FileSelectorModel
 
+    File system model with checkboxes. Checked paths are kept in
+    a PathSelection, and check states are looked up when items
+    are painted, so loaded descendants are never visited.
+
 ===========================================================
 */
 class FileSelectorModel : public QFileSystemModel
@@ -42,19 +47,11 @@ public:
     Qt::ItemFlags flags(const QModelIndex &index) const override;
 
     void setChecked(const QStringList &pathList);
-    void getPathList(QStringList &pathList, const QModelIndex &parent = QModelIndex()) const;
-
-private Q_SLOTS:
-
-    void updateCheckboxes(const QString &path);
+    void getPathList(QStringList &pathList) const;
 
 private:
 
-    void getChildren(QModelIndexList &list, const QModelIndex &parent) const;
-    void getAllChildren(QModelIndexList &list, const QModelIndex &parent) const;
-
-    QSet<QPersistentModelIndex> checkedList;
-    QSet<QPersistentModelIndex> partiallyCheckedList;
+    PathSelection selection;
 };
 
 #endif // FILESELECTORMODEL_H
@@ -0,0 +1,462 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <cstring>
+
+#include "FileTable.h"
+#include "Hash.h"
+
+#define FILETABLE_MIN_SLOTS 64
+
+/*
+===================
+hashName
+===================
+*/
+static inline quint64 hashName(quint32 parent, const char *name, qsizetype size)
+{
+    return xxHash64(name, size, parent);
+}
+
+/*
+===================
+insertSlot
+
+Slots are probed linearly from the hash, there's always a free one.
+===================
+*/
+static void insertSlot(QList<quint32> &slots, quint64 hash, quint32 index)
+{
+    qsizetype mask = slots.size() - 1;
+    qsizetype slot = hash & mask;
+
+    while (slots[slot])
+        slot = (slot + 1) & mask;
+
+    slots[slot] = index + 1;
+}
+
+/*
+===================
+FileTable::FileTable
+===================
+*/
+FileTable::FileTable()
+{
+    clear();
+}
+
+/*
+===================
+FileTable::clear
+===================
+*/
+void FileTable::clear()
+{
+    // The root's name is the empty string at the start of the arena
+    arena = QByteArray(1, '\0');
+    directories = {Directory{Root, 0, NotFound, NotFound, NotFound}};
+    files.clear();
+    directorySlots = QList<quint32>(FILETABLE_MIN_SLOTS, 0);
+    fileSlots = QList<quint32>(FILETABLE_MIN_SLOTS, 0);
+}
+
+/*
+===================
+FileTable::reserve
+===================
+*/
+void FileTable::reserve(int fileCount)
+{
+    files.reserve(fileCount);
+
+    while (fileSlots.size() < qsizetype(fileCount) * 2)
+        growFileSlots();
+}
+
+/*
+===================
+FileTable::addName
+===================
+*/
+quint32 FileTable::addName(const char *name, qsizetype size)
+{
+    quint32 offset = arena.size();
+    arena.append(name, size);
+    arena.append('\0');
+    return offset;
+}
+
+/*
+===================
+FileTable::findDirectory
+===================
+*/
+quint32 FileTable::findDirectory(quint32 parent, const char *name, qsizetype size) const
+{
+    qsizetype mask = directorySlots.size() - 1;
+
+    for (qsizetype slot = hashName(parent, name, size) & mask; directorySlots[slot]; slot = (slot + 1) & mask)
+    {
+        quint32 id = directorySlots[slot] - 1;
+        const Directory &directory = directories[id];
+        const char *other = arena.constData() + directory.name;
+
+        if (directory.parent == parent && !memcmp(other, name, size) && !other[size])
+            return id;
+    }
+
+    return NotFound;
+}
+
+/*
+===================
+FileTable::findFile
+===================
+*/
+int FileTable::findFile(quint32 directory, const char *name, qsizetype size) const
+{
+    qsizetype mask = fileSlots.size() - 1;
+
+    for (qsizetype slot = hashName(directory, name, size) & mask; fileSlots[slot]; slot = (slot + 1) & mask)
+    {
+        int index = fileSlots[slot] - 1;
+        const File &file = files[index];
+        const char *other = arena.constData() + file.name;
+
+        if (file.directory == directory && !memcmp(other, name, size) && !other[size])
+            return index;
+    }
+
+    return -1;
+}
+
+/*
+===================
+FileTable::addDirectory
+===================
+*/
+quint32 FileTable::addDirectory(quint32 parent, const QByteArray &name)
+{
+    quint32 id = findDirectory(parent, name.constData(), name.size());
+
+    if (id != NotFound)
+        return id;
+
+    if ((directories.size() + 1) * 2 > directorySlots.size())
+        growDirectorySlots();
+
+    id = directories.size();
+    directories.append(Directory{parent, addName(name.constData(), name.size()), NotFound, directories[parent].firstDirectory, NotFound});
+    directories[parent].firstDirectory = id;
+    insertSlot(directorySlots, hashName(parent, name.constData(), name.size()), id);
+
+    return id;
+}
+
+/*
+===================
+FileTable::addFile
+
+Returns the index of the file, which keeps its place if it has been
+added already.
+===================
+*/
+int FileTable::addFile(quint32 directory, const QByteArray &name)
+{
+    int index = findFile(directory, name.constData(), name.size());
+
+    if (index < 0)
+    {
+        if ((files.size() + 1) * 2 > fileSlots.size())
+            growFileSlots();
+
+        index = files.size();
+        files.append(File{directory, addName(name.constData(), name.size()), directories[directory].firstFile});
+        directories[directory].firstFile = index;
+        insertSlot(fileSlots, hashName(directory, name.constData(), name.size()), index);
+    }
+
+    return index;
+}
+
+/*
+===================
+FileTable::walkDirectories
+
+Follows the components of a directory path, separated by slashes, from
+the root. A leading slash is an empty first component, so absolute and
+relative paths never meet.
+===================
+*/
+quint32 FileTable::walkDirectories(const char *path, qsizetype size) const
+{
+    quint32 id = Root;
+    qsizetype begin = 0;
+
+    while (id != NotFound)
+    {
+        const char *slash = static_cast<const char *>(memchr(path + begin, '/', size - begin));
+        qsizetype end = (slash ? slash - path : size);
+
+        id = findDirectory(id, path + begin, end - begin);
+
+        if (end == size)
+            break;
+
+        begin = end + 1;
+    }
+
+    return id;
+}
+
+/*
+===================
+FileTable::addDirectories
+
+Like walkDirectories(), adding the components that are missing.
+===================
+*/
+quint32 FileTable::addDirectories(const char *path, qsizetype size)
+{
+    quint32 id = Root;
+    qsizetype begin = 0;
+
+    forever
+    {
+        const char *slash = static_cast<const char *>(memchr(path + begin, '/', size - begin));
+        qsizetype end = (slash ? slash - path : size);
+
+        id = addDirectory(id, QByteArray::fromRawData(path + begin, end - begin));
+
+        if (end == size)
+            return id;
+
+        begin = end + 1;
+    }
+}
+
+/*
+===================
+FileTable::addDirectoryPath
+===================
+*/
+quint32 FileTable::addDirectoryPath(const QString &path)
+{
+    QByteArray utf8 = path.toUtf8();
+
+    if (utf8.endsWith('/') && utf8.size() > 1)
+        utf8.chop(1);
+
+    return addDirectories(utf8.constData(), utf8.size());
+}
+
+/*
+===================
+FileTable::addFile
+===================
+*/
+int FileTable::addFile(const QString &path)
+{
+    QByteArray utf8 = path.toUtf8();
+    qsizetype slash = utf8.lastIndexOf('/');
+    quint32 directory = (slash < 0 ? Root : addDirectories(utf8.constData(), slash));
+
+    return addFile(directory, QByteArray::fromRawData(utf8.constData() + slash + 1, utf8.size() - slash - 1));
+}
+
+/*
+===================
+FileTable::find
+
+Returns the index of a file, or -1 if it isn't in the table.
+===================
+*/
+int FileTable::find(const QString &path) const
+{
+    QByteArray utf8 = path.toUtf8();
+    qsizetype slash = utf8.lastIndexOf('/');
+    quint32 directory = (slash < 0 ? Root : walkDirectories(utf8.constData(), slash));
+
+    if (directory == NotFound)
+        return -1;
+
+    return findFile(directory, utf8.constData() + slash + 1, utf8.size() - slash - 1);
+}
+
+/*
+===================
+FileTable::findDirectoryPath
+===================
+*/
+quint32 FileTable::findDirectoryPath(const QString &path) const
+{
+    QByteArray utf8 = path.toUtf8();
+
+    if (utf8.endsWith('/') && utf8.size() > 1)
+        utf8.chop(1);
+
+    return walkDirectories(utf8.constData(), utf8.size());
+}
+
+/*
+===================
+FileTable::appendPath
+===================
+*/
+void FileTable::appendPath(QByteArray &path, quint32 id) const
+{
+    if (id == Root)
+        return;
+
+    const Directory &directory = directories[id];
+    appendPath(path, directory.parent);
+
+    if (directory.parent != Root)
+        path.append('/');
+
+    path.append(name(directory.name));
+}
+
+/*
+===================
+FileTable::filePath
+===================
+*/
+QString FileTable::filePath(int index) const
+{
+    const File &file = files[index];
+    QByteArray path;
+
+    appendPath(path, file.directory);
+
+    if (file.directory != Root)
+        path.append('/');
+
+    path.append(name(file.name));
+    return QString::fromUtf8(path);
+}
+
+/*
+===================
+FileTable::directoryPath
+===================
+*/
+QString FileTable::directoryPath(quint32 id) const
+{
+    QByteArray path;
+    appendPath(path, id);
+
+    // The empty first component of an absolute path
+    if (path.isEmpty() && id != Root)
+        path = "/";
+
+    return QString::fromUtf8(path);
+}
+
+/*
+===================
+FileTable::isInside
+===================
+*/
+bool FileTable::isInside(int index, quint32 id) const
+{
+    for (quint32 directory = files[index].directory; ; directory = directories[directory].parent)
+    {
+        if (directory == id)
+            return true;
+
+        if (directory == Root)
+            return false;
+    }
+}
+
+/*
+===================
+FileTable::subdirectories
+===================
+*/
+QList<quint32> FileTable::subdirectories(quint32 id) const
+{
+    QList<quint32> ids;
+
+    for (quint32 child = directories[id].firstDirectory; child != NotFound; child = directories[child].nextDirectory)
+        ids.append(child);
+
+    return ids;
+}
+
+/*
+===================
+FileTable::directoryFiles
+===================
+*/
+QList<int> FileTable::directoryFiles(quint32 id) const
+{
+    QList<int> indexes;
+
+    for (quint32 index = directories[id].firstFile; index != NotFound; index = files[index].nextFile)
+        indexes.append(index);
+
+    return indexes;
+}
+
+/*
+===================
+FileTable::memoryUsage
+===================
+*/
+qint64 FileTable::memoryUsage() const
+{
+    return arena.capacity() + directories.capacity() * sizeof(Directory) + files.capacity() * sizeof(File) +
+           (directorySlots.capacity() + fileSlots.capacity()) * sizeof(quint32);
+}
+
+/*
+===================
+FileTable::growDirectorySlots
+===================
+*/
+void FileTable::growDirectorySlots()
+{
+    directorySlots = QList<quint32>(directorySlots.size() * 2, 0);
+
+    // The root isn't a child of anything
+    for (qsizetype id = 1; id < directories.size(); id++)
+    {
+        const char *directoryName = name(directories[id].name);
+        insertSlot(directorySlots, hashName(directories[id].parent, directoryName, strlen(directoryName)), id);
+    }
+}
+
+/*
+===================
+FileTable::growFileSlots
+===================
+*/
+void FileTable::growFileSlots()
+{
+    fileSlots = QList<quint32>(fileSlots.size() * 2, 0);
+
+    for (qsizetype index = 0; index < files.size(); index++)
+    {
+        const char *fileName = name(files[index].name);
+        insertSlot(fileSlots, hashName(files[index].directory, fileName, strlen(fileName)), index);
+    }
+}
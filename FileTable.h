@@ -0,0 +1,116 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/*
+===========================================================
+
+    FileTable
+
+    A compact table of file paths. Directories form a tree of
+    nodes, each holding its parent and its name, and files are
+    a flat array of their directory and name, anything else
+    about them is kept by the user of the table in the same order.
+    Names are UTF-8 and stored once in a single arena, so a
+    prefix shared by a million files takes no more room than
+    one. Files and directories are found through open hash
+    tables of plain indices. Every directory also links its
+    subdirectories and files, so the contents of a directory
+    are listed without going through the whole table.
+
+===========================================================
+*/
+class FileTable
+{
+public:
+
+    struct Directory
+    {
+        quint32 parent;
+        quint32 name;               // Offset in the arena
+        quint32 firstDirectory;     // Lists of the contents, ended by NotFound
+        quint32 nextDirectory;
+        quint32 firstFile;
+    };
+
+    struct File
+    {
+        quint32 directory;
+        quint32 name;       // Offset in the arena
+        quint32 nextFile;   // In the same directory
+    };
+
+    // Parent of top-level names, it has no name of its own
+    static constexpr quint32 Root = 0;
+    static constexpr quint32 NotFound = 0xFFFFFFFFu;
+
+    FileTable();
+
+    void clear();
+    void reserve(int fileCount);
+
+    quint32 addDirectory(quint32 parent, const QByteArray &name);
+    quint32 addDirectoryPath(const QString &path);
+    int addFile(quint32 directory, const QByteArray &name);
+    int addFile(const QString &path);
+
+    int find(const QString &path) const;
+    quint32 findDirectoryPath(const QString &path) const;
+
+    int fileCount() const { return files.size(); }
+    int directoryCount() const { return directories.size(); }
+    const File &file(int index) const { return files[index]; }
+    const Directory &directory(quint32 id) const { return directories[id]; }
+    const char *name(quint32 offset) const { return arena.constData() + offset; }
+
+    QString filePath(int index) const;
+    QString directoryPath(quint32 id) const;
+    bool isInside(int index, quint32 id) const;
+    QList<quint32> subdirectories(quint32 id) const;
+    QList<int> directoryFiles(quint32 id) const;
+
+    qint64 memoryUsage() const;
+
+private:
+
+    quint32 findDirectory(quint32 parent, const char *name, qsizetype size) const;
+    int findFile(quint32 directory, const char *name, qsizetype size) const;
+    quint32 walkDirectories(const char *path, qsizetype size) const;
+    quint32 addDirectories(const char *path, qsizetype size);
+    quint32 addName(const char *name, qsizetype size);
+    void appendPath(QByteArray &path, quint32 id) const;
+    void growDirectorySlots();
+    void growFileSlots();
+
+    QByteArray arena;
+    QList<Directory> directories;
+    QList<File> files;
+
+    // Open hash tables of indices plus one, 0 is an empty slot
+    QList<quint32> directorySlots;
+    QList<quint32> fileSlots;
+};
+
+#endif // FILETABLE_H
@@ -0,0 +1,901 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QCache>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QtEndian>
+#include <algorithm>
+
+#include "GitRepository.h"
+#include "IgnoreRules.h"
+
+#define MAX_DELTA_DEPTH         4096    // Longer chains are taken as a corrupted pack
+#define MAX_REF_DEPTH           8
+#define DELTA_BASE_CACHE_SIZE   (32 << 20)
+
+struct CachedObject
+{
+    GitRepository::ObjectType type;
+    QByteArray data;
+};
+
+struct GitRepository::Pack
+{
+    QFile packFile;
+    QFile indexFile;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+    const uchar *index = nullptr;
+    quint32 count = 0;
+
+    // Sorted, so the end of an object's data is where the next one starts
+    std::vector<qint64> offsets;
+
+    // Recently used delta bases, which are usually shared by many objects
+    QMutex mutex;
+    QCache<qint64, CachedObject> bases{DELTA_BASE_CACHE_SIZE};
+
+    const uchar *names() const { return index + 8 + 256 * 4; }
+
+    bool find(const QByteArray &id, qint64 &offset) const;
+    qint64 objectOffset(quint32 i) const;
+};
+
+/*
+===================
+GitRepository::Pack::find
+
+Looks an object up in the index, version 2, between the bounds the
+fan-out table gives for its first byte.
+===================
+*/
+bool GitRepository::Pack::find(const QByteArray &id, qint64 &offset) const
+{
+    const uchar *fanout = index + 8;
+    uchar first = id[0];
+    quint32 low = (first ? qFromBigEndian<quint32>(fanout + (first - 1) * 4) : 0);
+    quint32 high = qFromBigEndian<quint32>(fanout + first * 4);
+
+    while (low < high)
+    {
+        quint32 middle = low + (high - low) / 2;
+        int result = memcmp(names() + middle * OBJECT_ID_SIZE, id.constData(), OBJECT_ID_SIZE);
+
+        if (!result)
+        {
+            offset = objectOffset(middle);
+            return true;
+        }
+
+        if (result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return false;
+}
+
+/*
+===================
+GitRepository::Pack::objectOffset
+
+Offsets past 2 GB are kept in a separate table of 64-bit offsets.
+===================
+*/
+qint64 GitRepository::Pack::objectOffset(quint32 i) const
+{
+    const uchar *offsets32 = names() + count * (OBJECT_ID_SIZE + 4);
+    quint32 offset = qFromBigEndian<quint32>(offsets32 + i * 4);
+
+    if (!(offset & 0x80000000))
+        return offset;
+
+    const uchar *offsets64 = offsets32 + count * 4;
+    return qFromBigEndian<quint64>(offsets64 + (offset & 0x7FFFFFFF) * 8);
+}
+
+/*
+===================
+GitRepository::GitRepository
+===================
+*/
+GitRepository::GitRepository()
+{
+}
+
+/*
+===================
+GitRepository::~GitRepository
+===================
+*/
+GitRepository::~GitRepository()
+{
+}
+
+/*
+===================
+GitRepository::open
+
+Takes a working tree, a bare repository or a linked worktree.
+===================
+*/
+bool GitRepository::open(const QString &path)
+{
+    QFileInfo dotGit(path + "/.git");
+
+    packs.clear();
+
+    if (dotGit.isDir())
+    {
+        gitDir = dotGit.filePath();
+    }
+    else if (dotGit.isFile())
+    {
+        // Linked worktrees and submodules point to their git directory
+        QFile file(dotGit.filePath());
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+
+        QByteArray line = file.readLine().trimmed();
+
+        if (!line.startsWith("gitdir: "))
+            return false;
+
+        gitDir = QDir(path).absoluteFilePath(QString::fromUtf8(line.mid(8)));
+    }
+    else if (QFileInfo(path + "/objects").isDir() && QFileInfo(path + "/HEAD").isFile())
+    {
+        gitDir = path;
+    }
+    else
+    {
+        return false;
+    }
+
+    commonDir = gitDir;
+
+    QFile commonDirFile(gitDir + "/commondir");
+    if (commonDirFile.open(QIODevice::ReadOnly))
+        commonDir = QDir(gitDir).absoluteFilePath(QString::fromUtf8(commonDirFile.readLine().trimmed()));
+
+    if (!QFileInfo(commonDir + "/objects").isDir())
+        return false;
+
+    QDir packDir(commonDir + "/objects/pack");
+
+    for (auto &filename : packDir.entryList(QStringList("*.idx"), QDir::Files))
+        loadPack(packDir.filePath(filename));
+
+    return true;
+}
+
+/*
+===================
+GitRepository::loadPack
+
+Maps a pack and its index. Packs that can't be used are left out,
+their objects are simply not found.
+===================
+*/
+bool GitRepository::loadPack(const QString &indexFilename)
+{
+    auto pack = std::make_unique<Pack>();
+
+    pack->indexFile.setFileName(indexFilename);
+    pack->packFile.setFileName(indexFilename.chopped(4) + ".pack");
+
+    if (!pack->indexFile.open(QIODevice::ReadOnly) || !pack->packFile.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 indexSize = pack->indexFile.size();
+    pack->size = pack->packFile.size();
+
+    // Header and fan-out table of the index, header and checksum of the pack
+    if (indexSize < 8 + 256 * 4 || pack->size < 12 + OBJECT_ID_SIZE)
+        return false;
+
+    pack->index = pack->indexFile.map(0, indexSize);
+    pack->data = pack->packFile.map(0, pack->size);
+
+    if (!pack->index || !pack->data)
+        return false;
+
+    if (memcmp(pack->index, "\377tOc", 4) || qFromBigEndian<quint32>(pack->index + 4) != 2 || memcmp(pack->data, "PACK", 4))
+        return false;
+
+    pack->count = qFromBigEndian<quint32>(pack->index + 8 + 255 * 4);
+
+    if (indexSize < 8 + 256 * 4 + qint64(pack->count) * (OBJECT_ID_SIZE + 8) + OBJECT_ID_SIZE * 2)
+        return false;
+
+    pack->offsets.reserve(pack->count);
+
+    for (quint32 i = 0; i < pack->count; i++)
+        pack->offsets.push_back(pack->objectOffset(i));
+
+    std::sort(pack->offsets.begin(), pack->offsets.end());
+    packs.push_back(std::move(pack));
+
+    return true;
+}
+
+/*
+===================
+GitRepository::resolve
+
+Resolves a revision to the tree it points to.
+===================
+*/
+bool GitRepository::resolve(const QString &revision, QByteArray &treeId) const
+{
+    treeId.clear();
+
+    if (!resolveName(revision, treeId))
+        return false;
+
+    return peel(treeId, Tree);
+}
+
+/*
+===================
+GitRepository::history
+
+Lists the commits of a range, "<from>..<to>" or just "<to>", oldest
+first. Only first parents are followed, which is the history of the
+branch itself rather than of everything merged into it.
+===================
+*/
+bool GitRepository::history(const QString &range, QList<Revision> &revisions) const
+{
+    qsizetype dots = range.indexOf("..");
+    QString from = (dots >= 0 ? range.left(dots) : QString());
+    QString to = (dots >= 0 ? range.mid(dots + 2) : range);
+    QByteArray fromId, id;
+
+    if (to.isEmpty())
+        to = "HEAD";
+
+    if (!from.isEmpty() && (!resolveName(from, fromId) || !peel(fromId, Commit)))
+        return false;
+
+    if (!resolveName(to, id) || !peel(id, Commit))
+        return false;
+
+    revisions.clear();
+
+    while (!id.isEmpty() && id != fromId)
+    {
+        Revision revision;
+        QByteArray parentId;
+
+        if (!readCommit(id, revision, parentId))
+            return false;
+
+        revisions.append(revision);
+        id = parentId;
+    }
+
+    std::reverse(revisions.begin(), revisions.end());
+    return true;
+}
+
+/*
+===================
+GitRepository::readCommit
+
+Reads the tree, first parent and commit time from the header of a commit.
+===================
+*/
+bool GitRepository::readCommit(const QByteArray &id, Revision &revision, QByteArray &parentId) const
+{
+    ObjectType type;
+    QByteArray data;
+
+    if (!readObject(id, type, data) || type != Commit)
+        return false;
+
+    revision.id = id;
+    revision.treeId.clear();
+    parentId.clear();
+
+    for (auto &line : data.left(data.indexOf("\n\n")).split('\n'))
+    {
+        if (line.startsWith("tree "))
+        {
+            revision.treeId = QByteArray::fromHex(line.mid(5));
+        }
+        else if (line.startsWith("parent ") && parentId.isEmpty())
+        {
+            parentId = QByteArray::fromHex(line.mid(7));
+        }
+        else if (line.startsWith("committer "))
+        {
+            // "committer <name> <<email>> <seconds> <timezone>"
+            QList<QByteArray> fields = line.split(' ');
+
+            if (fields.size() >= 3)
+                revision.time = fields[fields.size() - 2].toLongLong() * 1000;
+        }
+    }
+
+    return (revision.treeId.size() == OBJECT_ID_SIZE);
+}
+
+/*
+===================
+GitRepository::peel
+
+Follows tags and commits until an object of the target type is reached.
+===================
+*/
+bool GitRepository::peel(QByteArray &id, ObjectType target) const
+{
+    for (int i = 0; i < MAX_REF_DEPTH; i++)
+    {
+        ObjectType type;
+        QByteArray data;
+
+        if (!readObject(id, type, data))
+            return false;
+
+        if (type == target)
+            return true;
+
+        // Both start with the object they point to
+        QByteArray field = (type == Commit ? "tree " : type == Tag ? "object " : QByteArray());
+
+        if (field.isEmpty() || (type == Commit && target != Tree) || !data.startsWith(field))
+            return false;
+
+        id = QByteArray::fromHex(data.mid(field.size(), OBJECT_ID_SIZE * 2));
+
+        if (id.size() != OBJECT_ID_SIZE)
+            return false;
+    }
+
+    return false;
+}
+
+/*
+===================
+GitRepository::resolveName
+
+Tries the names in the same order as git rev-parse does, then
+abbreviated object names.
+===================
+*/
+bool GitRepository::resolveName(const QString &revision, QByteArray &id) const
+{
+    static const QRegularExpression hexName("^[0-9a-fA-F]{4,40}$");
+    bool isHex = hexName.match(revision).hasMatch();
+
+    if (isHex && revision.size() == OBJECT_ID_SIZE * 2)
+    {
+        id = QByteArray::fromHex(revision.toLatin1());
+        return true;
+    }
+
+    QStringList names = {revision, "refs/" + revision, "refs/tags/" + revision, "refs/heads/" + revision,
+                         "refs/remotes/" + revision, "refs/remotes/" + revision + "/HEAD"};
+
+    for (auto &name : names)
+        if (resolveRef(name, id, 0))
+            return true;
+
+    return isHex && resolvePrefix(revision.toLower(), id);
+}
+
+/*
+===================
+GitRepository::resolveRef
+
+Follows symbolic refs, looking in packed-refs for refs that have no file.
+===================
+*/
+bool GitRepository::resolveRef(const QString &name, QByteArray &id, int depth) const
+{
+    if (depth > MAX_REF_DEPTH)
+        return false;
+
+    // HEAD and other per-worktree refs come first
+    for (auto &dir : {gitDir, commonDir})
+    {
+        QFile file(dir + '/' + name);
+        if (!QFileInfo(file).isFile() || !file.open(QIODevice::ReadOnly))
+            continue;
+
+        QByteArray line = file.readLine().trimmed();
+
+        if (line.startsWith("ref: "))
+            return resolveRef(QString::fromUtf8(line.mid(5)), id, depth + 1);
+
+        id = QByteArray::fromHex(line);
+        return (line.size() == OBJECT_ID_SIZE * 2 && id.size() == OBJECT_ID_SIZE);
+    }
+
+    QFile packedRefs(commonDir + "/packed-refs");
+    if (!packedRefs.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray ref = name.toUtf8();
+
+    while (!packedRefs.atEnd())
+    {
+        QByteArray line = packedRefs.readLine().trimmed();
+
+        // Skips the header and the peeled values of tags
+        if (line.startsWith('#') || line.startsWith('^'))
+            continue;
+
+        if (line.size() > OBJECT_ID_SIZE * 2 + 1 && line.mid(OBJECT_ID_SIZE * 2 + 1) == ref)
+        {
+            id = QByteArray::fromHex(line.left(OBJECT_ID_SIZE * 2));
+            return (id.size() == OBJECT_ID_SIZE);
+        }
+    }
+
+    return false;
+}
+
+/*
+===================
+GitRepository::resolvePrefix
+
+Finds the only object whose name starts with the given lowercase hex digits.
+===================
+*/
+bool GitRepository::resolvePrefix(const QString &hex, QByteArray &id) const
+{
+    QByteArray prefix = hex.toLatin1();
+    QList<QByteArray> found;
+
+    for (auto &name : QDir(commonDir + "/objects/" + hex.left(2)).entryList(QDir::Files))
+        if ((hex.left(2) + name).startsWith(hex))
+            found.append(QByteArray::fromHex((hex.left(2) + name).toLatin1()));
+
+    uchar first = QByteArray::fromHex(prefix.left(2))[0];
+
+    for (auto &pack : packs)
+    {
+        const uchar *fanout = pack->index + 8;
+        quint32 low = (first ? qFromBigEndian<quint32>(fanout + (first - 1) * 4) : 0);
+        quint32 high = qFromBigEndian<quint32>(fanout + first * 4);
+
+        for (quint32 i = low; i < high; i++)
+        {
+            QByteArray name(reinterpret_cast<const char *>(pack->names() + i * OBJECT_ID_SIZE), OBJECT_ID_SIZE);
+
+            if (name.toHex().startsWith(prefix) && !found.contains(name))
+                found.append(name);
+        }
+    }
+
+    // Ambiguous names aren't resolved
+    if (found.size() != 1)
+        return false;
+
+    id = found.first();
+    return true;
+}
+
+/*
+===================
+GitRepository::readObject
+===================
+*/
+bool GitRepository::readObject(const QByteArray &id, ObjectType &type, QByteArray &data) const
+{
+    if (id.size() != OBJECT_ID_SIZE)
+        return false;
+
+    // Most objects of a repository are packed
+    for (auto &pack : packs)
+    {
+        qint64 offset;
+
+        if (pack->find(id, offset))
+            return readPacked(*pack, offset, type, data, 0);
+    }
+
+    return readLoose(id, type, data);
+}
+
+/*
+===================
+GitRepository::readLoose
+
+A loose object is a compressed header, "<type> <size>\0", followed by its data.
+===================
+*/
+bool GitRepository::readLoose(const QByteArray &id, ObjectType &type, QByteArray &data) const
+{
+    QString hex = QString::fromLatin1(id.toHex());
+    QFile file(commonDir + "/objects/" + hex.left(2) + '/' + hex.mid(2));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray compressed = file.readAll();
+    QByteArray object;
+
+    // The size is only known once the header is inflated, the buffer grows as needed
+    inflate(reinterpret_cast<const uchar *>(compressed.constData()), compressed.size(), compressed.size() * 4, object);
+
+    qsizetype space = object.indexOf(' ');
+    qsizetype end = object.indexOf('\0');
+
+    if (space < 0 || end < space)
+        return false;
+
+    QByteArray typeName = object.left(space);
+    bool ok;
+    qint64 size = object.mid(space + 1, end - space - 1).toLongLong(&ok);
+
+    type = (typeName == "blob" ? Blob : typeName == "tree" ? Tree : typeName == "commit" ? Commit : typeName == "tag" ? Tag : None);
+
+    if (!ok || type == None || object.size() - end - 1 != size)
+        return false;
+
+    data = object.mid(end + 1);
+    return true;
+}
+
+/*
+===================
+GitRepository::readPacked
+
+Packed objects start with their type and size, followed by compressed
+data. Deltas are applied to their bases, which are read the same way.
+===================
+*/
+bool GitRepository::readPacked(Pack &pack, qint64 offset, ObjectType &type, QByteArray &data, int depth) const
+{
+    const uchar *end = pack.data + pack.size - OBJECT_ID_SIZE;
+    const uchar *p = pack.data + offset;
+
+    if (depth > MAX_DELTA_DEPTH || offset < 12 || p >= end)
+        return false;
+
+    uchar c = *p++;
+    int packType = (c >> 4) & 7;
+    qint64 size = c & 15;
+
+    for (int shift = 4; c & 0x80; shift += 7)
+    {
+        if (p >= end || shift > 56)
+            return false;
+
+        c = *p++;
+        size |= qint64(c & 0x7F) << shift;
+    }
+
+    qint64 baseOffset = 0;
+    QByteArray baseId;
+
+    if (packType == 6)
+    {
+        // Offset delta, relative to this object
+        if (p >= end)
+            return false;
+
+        c = *p++;
+        baseOffset = c & 0x7F;
+
+        while (c & 0x80)
+        {
+            if (p >= end)
+                return false;
+
+            c = *p++;
+            baseOffset = ((baseOffset + 1) << 7) | (c & 0x7F);
+        }
+
+        baseOffset = offset - baseOffset;
+    }
+    else if (packType == 7)
+    {
+        // Reference delta, by name
+        if (end - p < OBJECT_ID_SIZE)
+            return false;
+
+        baseId = QByteArray(reinterpret_cast<const char *>(p), OBJECT_ID_SIZE);
+        p += OBJECT_ID_SIZE;
+    }
+    else if (packType < Commit || packType > Tag)
+    {
+        return false;
+    }
+
+    auto next = std::upper_bound(pack.offsets.begin(), pack.offsets.end(), offset);
+    const uchar *dataEnd = (next != pack.offsets.end() ? pack.data + *next : end);
+
+    if (dataEnd < p || dataEnd > end)
+        return false;
+
+    if (packType != 6 && packType != 7)
+    {
+        type = static_cast<ObjectType>(packType);
+        return inflate(p, dataEnd - p, size, data);
+    }
+
+    QByteArray delta;
+
+    if (!inflate(p, dataEnd - p, size, delta))
+        return false;
+
+    ObjectType baseType;
+    QByteArray base;
+
+    if (packType == 6)
+    {
+        {
+            QMutexLocker locker(&pack.mutex);
+            CachedObject *cached = pack.bases.object(baseOffset);
+
+            if (cached)
+            {
+                baseType = cached->type;
+                base = cached->data;
+            }
+        }
+
+        if (base.isNull())
+        {
+            if (!readPacked(pack, baseOffset, baseType, base, depth + 1))
+                return false;
+
+            QMutexLocker locker(&pack.mutex);
+            pack.bases.insert(baseOffset, new CachedObject{baseType, base}, qMax<qsizetype>(base.size(), 1));
+        }
+    }
+    else if (!readObject(baseId, baseType, base))
+    {
+        return false;
+    }
+
+    type = baseType;
+    return applyDelta(base, delta, data);
+}
+
+/*
+===================
+GitRepository::walkTree
+
+Passes every file of a tree and its subtrees to the sink, with its
+path relative to the tree. Symbolic links and submodules are skipped.
+Files and subtrees matching the ignore patterns are skipped too, and
+so are the ones ignored by .gitignore and .ignore blobs of the tree
+when ignore files are enabled, just like in a working tree.
+===================
+*/
+bool GitRepository::walkTree(const QByteArray &treeId, const Sink &sink, const std::atomic<bool> &stopped,
+                             const QStringList &ignorePatterns, bool ignoreFiles) const
+{
+    std::shared_ptr<IgnoreRules> rules;
+
+    // Paths are matched with a leading slash, as if the tree was the root directory
+    if (!ignorePatterns.isEmpty())
+    {
+        rules = std::make_shared<IgnoreRules>("/");
+        rules->addPatterns(ignorePatterns);
+    }
+
+    return walkTree(treeId, QString(), rules, ignoreFiles, sink, stopped);
+}
+
+/*
+===================
+GitRepository::walkTree
+
+Entries are read first, so the ignore files of a tree are known before
+any of them is matched.
+===================
+*/
+bool GitRepository::walkTree(const QByteArray &treeId, const QString &prefix, const std::shared_ptr<const IgnoreRules> &rules, bool ignoreFiles,
+                             const Sink &sink, const std::atomic<bool> &stopped) const
+{
+    struct Entry
+    {
+        QByteArray mode;
+        QString name;
+        QByteArray id;
+    };
+
+    ObjectType type;
+    QByteArray tree;
+
+    if (!readObject(treeId, type, tree) || type != Tree)
+        return false;
+
+    // Entries are "<mode> <name>\0" followed by the binary name of the object
+    const char *p = tree.constData();
+    const char *end = p + tree.size();
+    QList<Entry> entries;
+
+    while (p < end)
+    {
+        const char *space = static_cast<const char *>(memchr(p, ' ', end - p));
+        const char *nul = (space ? static_cast<const char *>(memchr(space, '\0', end - space)) : nullptr);
+
+        if (!nul || end - nul - 1 < OBJECT_ID_SIZE)
+            return false;
+
+        entries.append(Entry{QByteArray(p, space - p), QString::fromUtf8(space + 1, nul - space - 1), QByteArray(nul + 1, OBJECT_ID_SIZE)});
+        p = nul + 1 + OBJECT_ID_SIZE;
+    }
+
+    std::shared_ptr<const IgnoreRules> entryRules = rules;
+
+    if (ignoreFiles)
+    {
+        auto treeRules = std::make_shared<IgnoreRules>('/' + prefix, rules);
+
+        for (auto &entry : entries)
+        {
+            QByteArray data;
+
+            if ((entry.name == ".gitignore" || entry.name == ".ignore") && entry.mode.startsWith("100") &&
+                readObject(entry.id, type, data) && type == Blob)
+                treeRules->addText(data);
+        }
+
+        if (!treeRules->isEmpty())
+            entryRules = treeRules;
+    }
+
+    for (auto &entry : entries)
+    {
+        if (stopped)
+            break;
+
+        bool isTree = (entry.mode == "40000");
+
+        if (!isTree && !entry.mode.startsWith("100"))
+            continue;
+
+        if (entryRules && entryRules->isIgnored('/' + prefix + entry.name, entry.name, isTree))
+            continue;
+
+        if (isTree)
+        {
+            if (!walkTree(entry.id, prefix + entry.name + '/', entryRules, ignoreFiles, sink, stopped))
+                return false;
+        }
+        else
+        {
+            sink(prefix + entry.name, entry.id);
+        }
+    }
+
+    return true;
+}
+
+/*
+===================
+GitRepository::inflate
+
+qUncompress expects the size of the data up front, in big-endian order.
+===================
+*/
+bool GitRepository::inflate(const uchar *data, qint64 size, qint64 expectedSize, QByteArray &result)
+{
+    QByteArray compressed(size + 4, Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(qMin<qint64>(expectedSize, 0xFFFFFFFF)), compressed.data());
+    memcpy(compressed.data() + 4, data, size);
+
+    result = qUncompress(compressed);
+    return (result.size() == expectedSize);
+}
+
+/*
+===================
+GitRepository::applyDelta
+
+A delta starts with the sizes of its base and of the result, followed
+by instructions to either copy a range of the base or insert new bytes.
+===================
+*/
+bool GitRepository::applyDelta(const QByteArray &base, const QByteArray &delta, QByteArray &result)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(delta.constData());
+    const uchar *end = p + delta.size();
+
+    auto readSize = [&p, end](qint64 &size)
+    {
+        size = 0;
+
+        for (int shift = 0; p < end && shift < 64; shift += 7)
+        {
+            uchar c = *p++;
+            size |= qint64(c & 0x7F) << shift;
+
+            if (!(c & 0x80))
+                return true;
+        }
+
+        return false;
+    };
+
+    qint64 baseSize, resultSize;
+
+    if (!readSize(baseSize) || !readSize(resultSize) || baseSize != base.size())
+        return false;
+
+    result.resize(resultSize);
+    char *out = result.data();
+    qint64 written = 0;
+
+    while (p < end)
+    {
+        uchar op = *p++;
+
+        if (op & 0x80)
+        {
+            // Copies from the base, only the bytes of the offset and size that are flagged are stored
+            qint64 copyOffset = 0, copySize = 0;
+
+            for (int i = 0; i < 4; i++)
+                if (op & (1 << i))
+                {
+                    if (p >= end)
+                        return false;
+
+                    copyOffset |= qint64(*p++) << (i * 8);
+                }
+
+            for (int i = 0; i < 3; i++)
+                if (op & (0x10 << i))
+                {
+                    if (p >= end)
+                        return false;
+
+                    copySize |= qint64(*p++) << (i * 8);
+                }
+
+            if (!copySize)
+                copySize = 0x10000;
+
+            if (copyOffset + copySize > baseSize || written + copySize > resultSize)
+                return false;
+
+            memcpy(out + written, base.constData() + copyOffset, copySize);
+            written += copySize;
+        }
+        else if (op)
+        {
+            // Inserts the next bytes of the delta
+            if (end - p < op || written + op > resultSize)
+                return false;
+
+            memcpy(out + written, p, op);
+            p += op;
+            written += op;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return (written == resultSize);
+}
@@ -0,0 +1,104 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef GITREPOSITORY_H
+#define GITREPOSITORY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define OBJECT_ID_SIZE 20   // SHA-1
+
+class IgnoreRules;
+
+/*
+===========================================================
+
+    GitRepository
+
+    Reads objects straight from the object database of a local
+    git repository, loose or packed, without a working tree.
+    Pack files and their indices are mapped once when the
+    repository is opened. Objects can be read from several
+    threads at a time.
+
+===========================================================
+*/
+class GitRepository
+{
+public:
+
+    enum ObjectType
+    {
+        None = 0,
+        Commit = 1,
+        Tree = 2,
+        Blob = 3,
+        Tag = 4
+    };
+
+    struct Revision
+    {
+        QByteArray id;
+        QByteArray treeId;
+        qint64 time = 0;    // Commit time in milliseconds since the epoch
+    };
+
+    typedef std::function<void(const QString &path, const QByteArray &id)> Sink;
+
+    GitRepository();
+    ~GitRepository();
+
+    bool open(const QString &path);
+
+    bool resolve(const QString &revision, QByteArray &treeId) const;
+    bool history(const QString &range, QList<Revision> &revisions) const;
+    bool readCommit(const QByteArray &id, Revision &revision, QByteArray &parentId) const;
+    bool readObject(const QByteArray &id, ObjectType &type, QByteArray &data) const;
+    bool walkTree(const QByteArray &treeId, const Sink &sink, const std::atomic<bool> &stopped,
+                  const QStringList &ignorePatterns = QStringList(), bool ignoreFiles = false) const;
+
+private:
+
+    struct Pack;
+
+    bool resolveName(const QString &revision, QByteArray &id) const;
+    bool peel(QByteArray &id, ObjectType target) const;
+    bool resolveRef(const QString &name, QByteArray &id, int depth) const;
+    bool resolvePrefix(const QString &hex, QByteArray &id) const;
+    bool readLoose(const QByteArray &id, ObjectType &type, QByteArray &data) const;
+    bool readPacked(Pack &pack, qint64 offset, ObjectType &type, QByteArray &data, int depth) const;
+    bool walkTree(const QByteArray &treeId, const QString &prefix, const std::shared_ptr<const IgnoreRules> &rules, bool ignoreFiles,
+                  const Sink &sink, const std::atomic<bool> &stopped) const;
+    bool loadPack(const QString &indexFilename);
+
+    static bool inflate(const uchar *data, qint64 size, qint64 expectedSize, QByteArray &result);
+    static bool applyDelta(const QByteArray &base, const QByteArray &delta, QByteArray &result);
+
+    QString gitDir;
+    QString commonDir;  // Differs from the git directory in linked worktrees
+    std::vector<std::unique_ptr<Pack>> packs;
+};
+
+#endif // GITREPOSITORY_H
@@ -0,0 +1,234 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QtEndian>
+#include <cstring>
+
+#include "Hash.h"
+
+// XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+static const quint64 prime1 = 0x9E3779B185EBCA87ULL;
+static const quint64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const quint64 prime3 = 0x165667B19E3779F9ULL;
+static const quint64 prime4 = 0x85EBCA77C2B2AE63ULL;
+static const quint64 prime5 = 0x27D4EB2F165667C5ULL;
+
+/*
+===================
+rotateLeft
+===================
+*/
+static inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/*
+===================
+read64
+===================
+*/
+static inline quint64 read64(const uchar *data)
+{
+    quint64 value;
+    memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+/*
+===================
+read32
+===================
+*/
+static inline quint32 read32(const uchar *data)
+{
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+/*
+===================
+xxRound
+===================
+*/
+static inline quint64 xxRound(quint64 acc, quint64 input)
+{
+    acc += input * prime2;
+    acc = rotateLeft(acc, 31);
+    return acc * prime1;
+}
+
+/*
+===================
+mergeRound
+===================
+*/
+static inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    acc ^= xxRound(0, value);
+    return acc * prime1 + prime4;
+}
+
+/*
+===================
+finish
+
+Mixes in the last bytes that don't fill a stripe of 32 bytes.
+===================
+*/
+static quint64 finish(quint64 hash, const uchar *p, const uchar *end)
+{
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= xxRound(0, read64(p));
+        hash = rotateLeft(hash, 27) * prime1 + prime4;
+    }
+
+    if (p + 4 <= end)
+    {
+        hash ^= static_cast<quint64>(read32(p)) * prime1;
+        hash = rotateLeft(hash, 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; p++)
+    {
+        hash ^= (*p) * prime5;
+        hash = rotateLeft(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/*
+===================
+mergeLanes
+===================
+*/
+static quint64 mergeLanes(const quint64 *v)
+{
+    quint64 hash = rotateLeft(v[0], 1) + rotateLeft(v[1], 7) + rotateLeft(v[2], 12) + rotateLeft(v[3], 18);
+
+    for (int i = 0; i < 4; i++)
+        hash = mergeRound(hash, v[i]);
+
+    return hash;
+}
+
+/*
+===================
+xxHash64
+===================
+*/
+quint64 xxHash64(const void *data, qint64 size, quint64 seed)
+{
+    const uchar *p = static_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    quint64 hash;
+
+    if (size >= 32)
+    {
+        quint64 v[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+
+        for (const uchar *limit = end - 32; p <= limit; p += 32)
+        {
+            v[0] = xxRound(v[0], read64(p));
+            v[1] = xxRound(v[1], read64(p + 8));
+            v[2] = xxRound(v[2], read64(p + 16));
+            v[3] = xxRound(v[3], read64(p + 24));
+        }
+
+        hash = mergeLanes(v);
+    }
+    else
+    {
+        hash = seed + prime5;
+    }
+
+    return finish(hash + static_cast<quint64>(size), p, end);
+}
+
+/*
+===================
+XxHash64::XxHash64
+===================
+*/
+XxHash64::XxHash64(quint64 seed) : seed(seed), v{seed + prime1 + prime2, seed + prime2, seed, seed - prime1}
+{
+}
+
+/*
+===================
+XxHash64::add
+
+Whole stripes go through the lanes right away, only the bytes short
+of a stripe are kept for the next piece.
+===================
+*/
+void XxHash64::add(const void *data, qint64 size)
+{
+    const uchar *p = static_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    total += size;
+
+    if (buffered)
+    {
+        int length = static_cast<int>(qMin<qint64>(32 - buffered, size));
+        memcpy(buffer + buffered, p, length);
+        buffered += length;
+        p += length;
+
+        if (buffered < 32)
+            return;
+
+        for (int i = 0; i < 4; i++)
+            v[i] = xxRound(v[i], read64(buffer + i * 8));
+
+        buffered = 0;
+    }
+
+    for (; end - p >= 32; p += 32)
+    {
+        v[0] = xxRound(v[0], read64(p));
+        v[1] = xxRound(v[1], read64(p + 8));
+        v[2] = xxRound(v[2], read64(p + 16));
+        v[3] = xxRound(v[3], read64(p + 24));
+    }
+
+    memcpy(buffer, p, end - p);
+    buffered = static_cast<int>(end - p);
+}
+
+/*
+===================
+XxHash64::result
+===================
+*/
+quint64 XxHash64::result() const
+{
+    quint64 hash = (total >= 32 ? mergeLanes(v) : seed + prime5);
+    return finish(hash + static_cast<quint64>(total), buffer, buffer + buffered);
+}
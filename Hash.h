@@ -0,0 +1,56 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <QtGlobal>
+
+quint64 xxHash64(const void *data, qint64 size, quint64 seed = 0);
+
+/*
+===========================================================
+
+    XxHash64
+
+    XXH64 of data that comes in pieces, such as a file mapped or
+    read a window at a time. Gives the same hash as xxHash64 of
+    all the pieces in one go.
+
+===========================================================
+*/
+class XxHash64
+{
+public:
+
+    explicit XxHash64(quint64 seed = 0);
+
+    void add(const void *data, qint64 size);
+    quint64 result() const;
+
+private:
+
+    quint64 seed;
+    quint64 v[4];
+    qint64 total = 0;
+    uchar buffer[32];
+    int buffered = 0;
+};
+
+#endif // HASH_H
@@ -0,0 +1,280 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QFile>
+
+#include "IgnoreRules.h"
+
+/*
+===================
+IgnoreRules::IgnoreRules
+===================
+*/
+IgnoreRules::IgnoreRules(const QString &basePath, std::shared_ptr<const IgnoreRules> parent)
+    : prefix(basePath.endsWith('/') ? basePath : basePath + '/'), parent(std::move(parent))
+{
+}
+
+/*
+===================
+IgnoreRules::addPattern
+
+Follows the .gitignore syntax: "#" starts a comment, "!" negates,
+a trailing "/" only matches directories, and a pattern with a slash
+anywhere else is relative to the base path instead of matching names
+at any depth.
+===================
+*/
+void IgnoreRules::addPattern(const QString &line)
+{
+    QString pattern = line;
+    Pattern entry;
+
+    // Trailing spaces, unless they're escaped
+    while (pattern.endsWith(' ') && !pattern.endsWith("\\ "))
+        pattern.chop(1);
+
+    if (pattern.isEmpty() || pattern.startsWith('#'))
+        return;
+
+    if (pattern.startsWith('!'))
+    {
+        entry.negated = true;
+        pattern.remove(0, 1);
+    }
+    else if (pattern.startsWith("\\!") || pattern.startsWith("\\#"))
+    {
+        pattern.remove(0, 1);
+    }
+
+    if (pattern.endsWith('/'))
+    {
+        entry.directoryOnly = true;
+        pattern.chop(1);
+    }
+
+    if (pattern.startsWith('/'))
+    {
+        entry.anchored = true;
+        pattern.remove(0, 1);
+    }
+    else if (pattern.contains('/'))
+    {
+        entry.anchored = true;
+    }
+
+    if (pattern.isEmpty())
+        return;
+
+    static const QRegularExpression wildcards("[*?\\[\\\\]");
+
+    if (!entry.anchored && !pattern.contains(wildcards))
+        entry.name = pattern;
+    else
+        entry.regex = QRegularExpression(toRegex(pattern));
+
+    if (entry.negated)
+        negations = true;
+    else if (!entry.name.isEmpty())
+        (entry.directoryOnly ? directoryNames : names).insert(entry.name);
+
+    patterns.append(entry);
+}
+
+/*
+===================
+IgnoreRules::addPatterns
+===================
+*/
+void IgnoreRules::addPatterns(const QStringList &patternList)
+{
+    for (auto &pattern : patternList)
+        addPattern(pattern);
+}
+
+/*
+===================
+IgnoreRules::addFile
+===================
+*/
+bool IgnoreRules::addFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    addText(file.readAll());
+    return true;
+}
+
+/*
+===================
+IgnoreRules::addText
+
+Adds the patterns of the contents of an ignore file, one per line.
+===================
+*/
+void IgnoreRules::addText(const QByteArray &text)
+{
+    for (auto &line : text.split('\n'))
+        addPattern(QString::fromUtf8(line.endsWith('\r') ? line.chopped(1) : line));
+}
+
+/*
+===================
+IgnoreRules::isIgnored
+
+The first rules along the chain with a matching pattern decide.
+===================
+*/
+bool IgnoreRules::isIgnored(const QString &path, const QString &name, bool isDir) const
+{
+    for (const IgnoreRules *rules = this; rules; rules = rules->parent.get())
+    {
+        int result = rules->match(path, name, isDir);
+
+        if (result >= 0)
+            return result;
+    }
+
+    return false;
+}
+
+/*
+===================
+IgnoreRules::match
+
+Returns 1 when ignored, 0 when included again by a negated pattern
+and -1 when no pattern matches. The last matching pattern wins, so
+plain names can only be looked up first when nothing is negated.
+===================
+*/
+int IgnoreRules::match(const QString &path, const QString &name, bool isDir) const
+{
+    if (!negations && (names.contains(name) || (isDir && directoryNames.contains(name))))
+        return 1;
+
+    for (qsizetype i = patterns.size() - 1; i >= 0; i--)
+    {
+        const Pattern &pattern = patterns[i];
+        bool matched;
+
+        if (pattern.directoryOnly && !isDir)
+            continue;
+
+        if (!pattern.name.isEmpty())
+        {
+            if (!negations)
+                continue;
+
+            matched = (name == pattern.name);
+        }
+        else if (pattern.anchored)
+        {
+            if (!path.startsWith(prefix))
+                continue;
+
+            matched = pattern.regex.match(path, prefix.size(), QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption).hasMatch();
+        }
+        else
+        {
+            matched = pattern.regex.match(name, 0, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption).hasMatch();
+        }
+
+        if (matched)
+            return pattern.negated ? 0 : 1;
+    }
+
+    return -1;
+}
+
+/*
+===================
+IgnoreRules::toRegex
+
+"*" and "?" don't match slashes, "**" between slashes matches any
+number of directories and a trailing "**" everything below.
+===================
+*/
+QString IgnoreRules::toRegex(const QString &glob)
+{
+    QString regex;
+
+    for (qsizetype i = 0; i < glob.size(); i++)
+    {
+        QChar c = glob[i];
+
+        if (c == '*')
+        {
+            bool doubleStar = (i + 1 < glob.size() && glob[i + 1] == '*');
+            bool afterSlash = (i == 0 || glob[i - 1] == '/');
+
+            if (doubleStar && afterSlash && i + 2 < glob.size() && glob[i + 2] == '/')
+            {
+                regex += "(?:.*/)?";
+                i += 2;
+            }
+            else if (doubleStar && afterSlash && i + 2 == glob.size())
+            {
+                regex += ".*";
+                i++;
+            }
+            else
+            {
+                regex += "[^/]*";
+
+                while (i + 1 < glob.size() && glob[i + 1] == '*')
+                    i++;
+            }
+        }
+        else if (c == '?')
+        {
+            regex += "[^/]";
+        }
+        else if (c == '[')
+        {
+            // "]" right after the opening bracket is part of the set
+            qsizetype end = glob.indexOf(']', i + 2);
+
+            if (end < 0)
+            {
+                regex += "\\[";
+                continue;
+            }
+
+            QString set = glob.mid(i + 1, end - i - 1);
+
+            if (set.startsWith('!'))
+                set[0] = '^';
+
+            regex += '[' + set.replace("[", "\\[") + ']';
+            i = end;
+        }
+        else if (c == '\\' && i + 1 < glob.size())
+        {
+            regex += QRegularExpression::escape(glob.mid(++i, 1));
+        }
+        else
+        {
+            regex += QRegularExpression::escape(QString(c));
+        }
+    }
+
+    return regex + "\\z";
+}
@@ -0,0 +1,79 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef IGNORERULES_H
+#define IGNORERULES_H
+
+#include <QList>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStringList>
+#include <memory>
+
+/*
+===========================================================
+
+    IgnoreRules
+
+    Patterns of files and directories to skip, in the syntax of
+    .gitignore files, relative to the directory they belong to.
+    Plain names like "node_modules" are looked up in a hash,
+    other patterns are compiled into regular expressions once.
+    Rules of a subdirectory take precedence over the rules of
+    its parents, which they're chained to.
+
+===========================================================
+*/
+class IgnoreRules
+{
+public:
+
+    IgnoreRules(const QString &basePath, std::shared_ptr<const IgnoreRules> parent = nullptr);
+
+    void addPattern(const QString &pattern);
+    void addPatterns(const QStringList &patternList);
+    bool addFile(const QString &filename);
+    void addText(const QByteArray &text);
+
+    bool isEmpty() const { return patterns.isEmpty(); }
+    bool isIgnored(const QString &path, const QString &name, bool isDir) const;
+
+private:
+
+    struct Pattern
+    {
+        QRegularExpression regex;
+        QString name;           // Set when the pattern is a plain name
+        bool negated = false;
+        bool directoryOnly = false;
+        bool anchored = false;  // Matches the path relative to the base path instead of the name
+    };
+
+    static QString toRegex(const QString &glob);
+    int match(const QString &path, const QString &name, bool isDir) const;
+
+    QString prefix;
+    std::shared_ptr<const IgnoreRules> parent;
+    QList<Pattern> patterns;
+    QSet<QString> names;
+    QSet<QString> directoryNames;
+    bool negations = false;
+};
+
+#endif // IGNORERULES_H
@@ -0,0 +1,80 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QHash>
+
+#include "Language.h"
+
+/*
+===================
+getExtensionTable
+
+Built once, extensions are stored in lowercase.
+===================
+*/
+static const QHash<QString, Language::Type> &getExtensionTable()
+{
+    static const QHash<QString, Language::Type> extensionTable = []()
+    {
+        QHash<QString, Language::Type> table;
+
+        for (int i = 0; i < Language::TypeCount; i++)
+            for (int j = 0; langList[i].ext[j]; j++)
+                table.insert(QString(langList[i].ext[j]).toLower(), static_cast<Language::Type>(i));
+
+        return table;
+    }();
+
+    return extensionTable;
+}
+
+/*
+===================
+getLanguageType
+===================
+*/
+Language::Type getLanguageType(const QString &ext)
+{
+    return getExtensionTable().value(ext.toLower(), Language::None);
+}
+
+/*
+===================
+getFileLanguageType
+
+Tries the complete suffix first, then falls back to the last suffix,
+so names like "foo.test.js" are still counted.
+===================
+*/
+Language::Type getFileLanguageType(const QString &filename)
+{
+    qsizetype first = filename.indexOf('.');
+
+    if (first < 0)
+        return Language::None;
+
+    Language::Type type = getLanguageType(filename.mid(first + 1));
+
+    qsizetype last = filename.lastIndexOf('.');
+
+    if (type == Language::None && last > first)
+        type = getLanguageType(filename.mid(last + 1));
+
+    return type;
+}
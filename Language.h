@@ -0,0 +1,163 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef LANGUAGE_H
+#define LANGUAGE_H
+
+#include <QByteArray>
+#include <QString>
+
+enum cursorState
+{
+    None,
+    StringLiteral,
+    CharacterLiteral,
+    SingleLineComment,
+    MultiLineComment
+};
+
+struct Language
+{
+    enum Type
+    {
+        Assembly,
+        Basic,
+        C,
+        CSharp,
+        CPP,
+        CHeader,
+        Clojure,
+        CoffeeScript,
+        D,
+        FSharp,
+        GLSL,
+        Go,
+        Groovy,
+        Haskell,
+        HLSL,
+        Java,
+        JavaScript,
+        Kotlin,
+        Lisp,
+        Lua,
+        ObjectC,
+        PERL,
+        Pascal,
+        PHP,
+        Python,
+        R,
+        Ruby,
+        Rust,
+        Scala,
+        SQL,
+        Swift,
+        TypeScript,
+        TypeCount,
+        None
+    } type;
+
+    const char *name;
+    const char *singleComment[16];
+    const char *multipleCommentStart[16];
+    const char *multipleCommentEnd[16];
+    const char *ext[16];
+};
+
+struct SourceFile
+{
+    QString filename;
+    Language::Type langType;
+    qint64 size = 0;
+    qint64 lastModified = 0;
+    QByteArray objectId;    // Blob of a file in a git revision
+    quint64 device = 0;     // Device and inode identify a file on disk where they're known
+    quint64 inode = 0;
+};
+
+struct MetricsData
+{
+    int sourceFiles = 0;
+    int lines = 0;
+    int linesOfCode = 0;
+    int commentLines = 0;
+    int commentWords = 0;
+    int blankLines = 0;
+
+    MetricsData &operator+=(const MetricsData &other)
+    {
+        sourceFiles += other.sourceFiles;
+        lines += other.lines;
+        linesOfCode += other.linesOfCode;
+        commentLines += other.commentLines;
+        commentWords += other.commentWords;
+        blankLines += other.blankLines;
+        return *this;
+    }
+
+    MetricsData &operator-=(const MetricsData &other)
+    {
+        sourceFiles -= other.sourceFiles;
+        lines -= other.lines;
+        linesOfCode -= other.linesOfCode;
+        commentLines -= other.commentLines;
+        commentWords -= other.commentWords;
+        blankLines -= other.blankLines;
+        return *this;
+    }
+};
+
+// Constant, so comment syntax can be built into the classifier at compile time
+inline constexpr Language langList[Language::TypeCount] = {
+{ Language::Assembly,    "Assembly",       {"//", ";", "#"},   {"/*"},                 {"*/"},                 {"asm", "nasm", "s"}},
+{ Language::Basic,       "BASIC",          {"'", "REM"},       {},                     {},                     {"bas", "vb"}},
+{ Language::C,           "C",              {"//"},             {"/*"},                 {"*/"},                 {"c"}},
+{ Language::CSharp,      "C#",             {"//"},             {"/*"},                 {"*/"},                 {"cs"}},
+{ Language::CPP,         "C++",            {"//"},             {"/*"},                 {"*/"},                 {"cpp", "cc", "cxx", "c++", "inl", "ipp"}},
+{ Language::CHeader,     "C/C++ Header",   {"//"},             {"/*"},                 {"*/"},                 {"h", "hh", "hpp", "h++", "hxx"}},
+{ Language::Clojure,     "Clojure",        {";"},              {},                     {},                     {"clj", "cljs", "cljc", "edn"}},
+{ Language::CoffeeScript,"CoffeeScript",   {"#"},              {"###"},                {"###"},                {"coffee", "litcoffee"}},
+{ Language::D,           "D",              {"//"},             {"/*", "/+"},           {"*/", "+/"},           {"d"}},
+{ Language::FSharp,      "F#",             {"//"},             {"/*", "(*"},           {"*/", "*)"},           {"fs", "fsx"}},
+{ Language::GLSL,        "GLSL",           {"//"},             {"/*"},                 {"*/"},                 {"vert", "tesc", "tese", "geom", "frag", "comp", "glsl", "glslv"}},
+{ Language::Go,          "Go",             {"//"},             {"/*"},                 {"*/"},                 {"go"}},
+{ Language::Groovy,      "Groovy",         {"//"},             {"/*"},                 {"*/"},                 {"groovy", "gvy", "gy", "gsh"}},
+{ Language::Haskell,     "Haskell",        {"--"},             {"{-"},                 {"-}"},                 {"hs", "lhs"}},
+{ Language::HLSL,        "HLSL",           {"//"},             {"/*"},                 {"*/"},                 {"hlsl"}},
+{ Language::Java,        "Java",           {"//"},             {"/*"},                 {"*/"},                 {"java"}},
+{ Language::JavaScript,  "JavaScript",     {"//"},             {"/*"},                 {"*/"},                 {"js", "json"}},
+{ Language::Kotlin,      "Kotlin",         {"//"},             {"/*"},                 {"*/"},                 {"kt", "kts"}},
+{ Language::Lisp,        "Lisp",           {"//"},             {"#|"},                 {"|#"},                 {"lisp"}},
+{ Language::Lua,         "Lua",            {"--"},             {"/*", "--[["},         {"*/", "]]"},           {"lua"}},
+{ Language::ObjectC,     "Object-C",       {"//"},             {"/*"},                 {"*/"},                 {"m", "mm"}},
+{ Language::PERL,        "Perl",           {"#"},              {},                     {},                     {"pl", "pm", "perl", "t", "pod"}},
+{ Language::Pascal,      "Pascal",         {"//"},             {"(*", "{"},            {"*)", "}"},            {"pas", "p"}},
+{ Language::PHP,         "PHP",            {"#"},              {"/*"},                 {"*/"},                 {"php", "phtml", "php3", "php4", "php5", "phps"}},
+{ Language::Python,      "Python",         {"#"},              {"\"\"\"", "\'\'\'"},   {"\"\"\"", "\'\'\'"},   {"py"}},
+{ Language::R,           "R",              {"#"},              {},                     {},                     {"r"}},
+{ Language::Ruby,        "Ruby",           {"#"},              {"=begin"},             {"=end"},               {"rb", "rbw"}},
+{ Language::Rust,        "Rust",           {"//"},             {"/*"},                 {"*/"},                 {"rs"}},
+{ Language::Scala,       "Scala",          {"//"},             {"/*"},                 {"*/"},                 {"scala"}},
+{ Language::SQL,         "SQL",            {"#", "--"},        {"/*"},                 {"*/"},                 {"sql"}},
+{ Language::Swift,       "Swift",          {"//"},             {"/*"},                 {"*/"},                 {"swift"}},
+{ Language::TypeScript,  "TypeScript",     {"//"},             {"/*"},                 {"*/"},                 {"ts", "tsx"}}};
+
+Language::Type getLanguageType(const QString &ext);
+Language::Type getFileLanguageType(const QString &filename);
+
+#endif // LANGUAGE_H
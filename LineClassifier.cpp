@@ -0,0 +1,990 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QFile>
+#include <QList>
+#include <QStringConverter>
+#include <QThread>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <cstring>
+#include <utility>
+
+#include "LineClassifier.h"
+
+// SSE2 is always there on x86-64, AVX2 has to be enabled with -mavx2 or /arch:AVX2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VECTOR_SIZE 32
+#define VECTOR_MASK 0xFFFFFFFFu
+typedef __m256i Vector;
+static inline Vector load(const uchar *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+static inline Vector splat(uchar c) { return _mm256_set1_epi8(static_cast<char>(c)); }
+static inline Vector zero() { return _mm256_setzero_si256(); }
+static inline Vector equal(Vector a, Vector b) { return _mm256_cmpeq_epi8(a, b); }
+static inline Vector greater(Vector a, Vector b) { return _mm256_cmpgt_epi8(a, b); }
+static inline Vector bitOr(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+static inline Vector bitAnd(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+static inline quint32 mask(Vector v) { return static_cast<quint32>(_mm256_movemask_epi8(v)); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECTOR_SIZE 16
+#define VECTOR_MASK 0xFFFFu
+typedef __m128i Vector;
+static inline Vector load(const uchar *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+static inline Vector splat(uchar c) { return _mm_set1_epi8(static_cast<char>(c)); }
+static inline Vector zero() { return _mm_setzero_si128(); }
+static inline Vector equal(Vector a, Vector b) { return _mm_cmpeq_epi8(a, b); }
+static inline Vector greater(Vector a, Vector b) { return _mm_cmpgt_epi8(a, b); }
+static inline Vector bitOr(Vector a, Vector b) { return _mm_or_si128(a, b); }
+static inline Vector bitAnd(Vector a, Vector b) { return _mm_and_si128(a, b); }
+static inline quint32 mask(Vector v) { return static_cast<quint32>(_mm_movemask_epi8(v)); }
+#endif
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+#define READ_BUFFER_SIZE (1 << 20)
+
+struct ByteSet
+{
+    constexpr void add(uchar c)
+    {
+        if (contains[c])
+            return;
+
+        contains[c] = true;
+        bytes[count++] = c;
+    }
+
+    uchar bytes[16] = {};
+    bool contains[256] = {};
+    int count = 0;
+};
+
+struct Marker
+{
+    const char *text = nullptr;
+    int length = 0;
+    bool columnZero = false;
+    bool multiLine = false;
+};
+
+/*
+===========================================================
+
+    Syntax
+
+    Comment markers of a language, built at compile time. Each
+    byte maps to a mask of the markers that start with it, so
+    a byte that can't begin a marker costs a single lookup.
+
+===========================================================
+*/
+struct Syntax
+{
+    Marker start[32];
+    Marker end[32];
+    int startCount = 0;
+    int endCount = 0;
+
+    quint32 startsWith[256] = {};
+    quint32 endsWith[256] = {};
+
+    ByteSet codeStops;
+    ByteSet commentStops;
+};
+
+/*
+===================
+markerLength
+===================
+*/
+static constexpr int markerLength(const char *text)
+{
+    int length = 0;
+
+    while (text[length])
+        length++;
+
+    return length;
+}
+
+/*
+===================
+makeSyntax
+
+Markers are kept in the order the original per-character loop checked
+them in, single line comments first for every index, so that a shorter
+marker with a common prefix still takes precedence.
+===================
+*/
+static constexpr Syntax makeSyntax(Language::Type type)
+{
+    const Language &language = langList[type];
+    Syntax syntax;
+
+    // Ruby's =begin and =end only count at the beginning of a line
+    bool columnZero = (type == Language::Ruby);
+
+    for (int k = 0; language.singleComment[k] || language.multipleCommentStart[k]; k++)
+    {
+        if (language.singleComment[k])
+            syntax.start[syntax.startCount++] = Marker{language.singleComment[k], markerLength(language.singleComment[k]), false, false};
+
+        if (language.multipleCommentStart[k])
+            syntax.start[syntax.startCount++] = Marker{language.multipleCommentStart[k], markerLength(language.multipleCommentStart[k]), columnZero, true};
+    }
+
+    for (int k = 0; language.multipleCommentEnd[k]; k++)
+        syntax.end[syntax.endCount++] = Marker{language.multipleCommentEnd[k], markerLength(language.multipleCommentEnd[k]), columnZero, true};
+
+    for (int i = 0; i < syntax.startCount; i++)
+    {
+        uchar first = static_cast<uchar>(syntax.start[i].text[0]);
+        syntax.startsWith[first] |= 1u << i;
+        syntax.codeStops.add(first);
+    }
+
+    for (int i = 0; i < syntax.endCount; i++)
+    {
+        uchar first = static_cast<uchar>(syntax.end[i].text[0]);
+        syntax.endsWith[first] |= 1u << i;
+        syntax.commentStops.add(first);
+    }
+
+    syntax.codeStops.add('\"');
+    syntax.codeStops.add('\'');
+
+    return syntax;
+}
+
+template <Language::Type T>
+static constexpr Syntax syntaxOf = makeSyntax(T);
+
+/*
+===================
+makeLiteralStops
+===================
+*/
+static constexpr ByteSet makeLiteralStops(uchar quote)
+{
+    ByteSet stops;
+    stops.add(quote);
+    stops.add('\\');
+
+    return stops;
+}
+
+static constexpr ByteSet stringStops = makeLiteralStops('\"');
+static constexpr ByteSet characterStops = makeLiteralStops('\'');
+
+/*
+===================
+isAsciiLetter
+===================
+*/
+static inline bool isAsciiLetter(uchar c)
+{
+    return static_cast<uchar>((c | 0x20) - 'a') < 26;
+}
+
+/*
+===================
+isAsciiSpace
+===================
+*/
+static inline bool isAsciiSpace(uchar c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/*
+===================
+decode
+
+Decodes a UTF-8 sequence the same way QTextStream does, an invalid
+byte turns into a single replacement character.
+===================
+*/
+static char32_t decode(const uchar *&p, const uchar *end)
+{
+    uchar c = *p++;
+
+    if (c < 0x80)
+        return c;
+
+    int length;
+    char32_t ucs4, minimum;
+
+    if ((c & 0xE0) == 0xC0)
+    {
+        length = 1;
+        ucs4 = c & 0x1F;
+        minimum = 0x80;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        length = 2;
+        ucs4 = c & 0x0F;
+        minimum = 0x800;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        length = 3;
+        ucs4 = c & 0x07;
+        minimum = 0x10000;
+    }
+    else
+    {
+        return REPLACEMENT_CHARACTER;
+    }
+
+    if (end - p < length)
+        return REPLACEMENT_CHARACTER;
+
+    for (int i = 0; i < length; i++)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+            return REPLACEMENT_CHARACTER;
+
+        ucs4 = (ucs4 << 6) | (p[i] & 0x3F);
+    }
+
+    if (ucs4 < minimum || ucs4 > 0x10FFFF || (ucs4 >= 0xD800 && ucs4 <= 0xDFFF))
+        return REPLACEMENT_CHARACTER;
+
+    p += length;
+    return ucs4;
+}
+
+/*
+===================
+isLetter
+
+Characters outside of the BMP are stored as surrogate pairs in a QString,
+and neither half of a pair is a letter.
+===================
+*/
+static inline bool isLetter(char32_t ucs4)
+{
+    return ucs4 < 0x80 ? isAsciiLetter(ucs4) : ucs4 <= 0xFFFF && QChar::isLetter(ucs4);
+}
+
+/*
+===================
+isLetterOrNumberAt
+===================
+*/
+static inline bool isLetterOrNumberAt(const uchar *p, const uchar *end)
+{
+    if (p >= end)
+        return false;
+
+    char32_t ucs4 = decode(p, end);
+    return ucs4 < 0x80 ? isAsciiLetter(ucs4) || (ucs4 >= '0' && ucs4 <= '9') : ucs4 <= 0xFFFF && QChar::isLetterOrNumber(ucs4);
+}
+
+#ifdef VECTOR_SIZE
+/*
+===================
+validMask
+
+Bits of the bytes of a vector that lie before the end of a line.
+===================
+*/
+static inline quint32 validMask(const uchar *p, const uchar *end)
+{
+    return end - p >= VECTOR_SIZE ? VECTOR_MASK : (1u << (end - p)) - 1;
+}
+#endif
+
+/*
+===================
+findNewline
+===================
+*/
+static const uchar *findNewline(const uchar *p, const uchar *end)
+{
+#ifdef VECTOR_SIZE
+    for (Vector newline = splat('\n'); end - p >= VECTOR_SIZE; p += VECTOR_SIZE)
+    {
+        quint32 bits = mask(equal(load(p), newline));
+
+        if (bits)
+            return p + qCountTrailingZeroBits(bits);
+    }
+#endif
+
+    while (p < end && *p != '\n')
+        p++;
+
+    return p;
+}
+
+/*
+===================
+findAny
+
+Returns the first byte of a line that belongs to the set. Vectors may
+read past the end of the line, but never past the limit of the buffer.
+===================
+*/
+static const uchar *findAny(const uchar *p, const uchar *end, const uchar *limit, const ByteSet &set)
+{
+    if (!set.count)
+        return end;
+
+#ifdef VECTOR_SIZE
+    Vector stops[16];
+
+    for (int i = 0; i < set.count; i++)
+        stops[i] = splat(set.bytes[i]);
+
+    for (; p < end && limit - p >= VECTOR_SIZE; p += VECTOR_SIZE)
+    {
+        Vector v = load(p);
+        Vector matches = zero();
+
+        for (int i = 0; i < set.count; i++)
+            matches = bitOr(matches, equal(v, stops[i]));
+
+        quint32 bits = mask(matches) & validMask(p, end);
+
+        if (bits)
+            return p + qCountTrailingZeroBits(bits);
+    }
+
+    if (p >= end)
+        return end;
+#else
+    Q_UNUSED(limit);
+#endif
+
+    while (p < end && !set.contains[*p])
+        p++;
+
+    return p;
+}
+
+/*
+===================
+hasPrintable
+===================
+*/
+static bool hasPrintable(const uchar *p, const uchar *end, const uchar *limit)
+{
+#ifdef VECTOR_SIZE
+    for (; p < end && limit - p >= VECTOR_SIZE; p += VECTOR_SIZE)
+    {
+        Vector v = load(p);
+
+        if (mask(bitAnd(greater(v, splat(' ')), greater(splat(0x7F), v))) & validMask(p, end))
+            return true;
+    }
+#else
+    Q_UNUSED(limit);
+#endif
+
+    for (; p < end; p++)
+        if (*p >= '!' && *p <= '~')
+            return true;
+
+    return false;
+}
+
+/*
+===================
+isBlank
+===================
+*/
+static bool isBlank(const uchar *p, const uchar *end, const uchar *limit)
+{
+#ifdef VECTOR_SIZE
+    for (; p < end && limit - p >= VECTOR_SIZE; p += VECTOR_SIZE)
+    {
+        Vector v = load(p);
+        quint32 spaces = mask(bitOr(equal(v, splat(' ')), bitAnd(greater(v, splat('\t' - 1)), greater(splat('\r' + 1), v))));
+        quint32 valid = validMask(p, end);
+
+        // Anything but ASCII whitespace is checked one character at a time
+        if ((spaces & valid) != valid)
+        {
+            p += qCountTrailingZeroBits(~spaces & valid);
+            break;
+        }
+    }
+#else
+    Q_UNUSED(limit);
+#endif
+
+    while (p < end)
+    {
+        if (*p < 0x80)
+        {
+            if (!isAsciiSpace(*p++))
+                return false;
+        }
+        else
+        {
+            char32_t ucs4 = decode(p, end);
+
+            if (ucs4 > 0xFFFF || !QChar::isSpace(ucs4))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+===================
+countWord
+===================
+*/
+static inline int countWord(const uchar *&p, const uchar *end, bool &previousLetter)
+{
+    bool letter = isLetter(decode(p, end));
+    int word = letter && !previousLetter;
+
+    previousLetter = letter;
+    return word;
+}
+
+/*
+===================
+countWords
+
+Counts letters that follow a character that isn't a letter. Blocks of
+pure ASCII are counted with a single population count.
+===================
+*/
+static int countWords(const uchar *p, const uchar *end, const uchar *limit, bool &previousLetter)
+{
+    int words = 0;
+
+#ifdef VECTOR_SIZE
+    while (p < end && limit - p >= VECTOR_SIZE)
+    {
+        Vector v = load(p);
+        quint32 valid = validMask(p, end);
+
+        if (mask(v) & valid)
+        {
+            for (const uchar *blockEnd = p + qMin<qsizetype>(VECTOR_SIZE, end - p); p < blockEnd;)
+                words += countWord(p, end, previousLetter);
+
+            continue;
+        }
+
+        Vector lower = bitOr(v, splat(0x20));
+        quint32 letters = mask(bitAnd(greater(lower, splat('a' - 1)), greater(splat('z' + 1), lower))) & valid;
+        quint32 starts = letters & ~((letters << 1) | (previousLetter ? 1u : 0u));
+        int length = qMin<qsizetype>(VECTOR_SIZE, end - p);
+
+        words += qPopulationCount(starts);
+        previousLetter = (letters >> (length - 1)) & 1;
+        p += length;
+    }
+#else
+    Q_UNUSED(limit);
+#endif
+
+    while (p < end)
+        words += countWord(p, end, previousLetter);
+
+    return words;
+}
+
+/*
+===================
+matchMarker
+
+Only the markers that begin with the byte under the cursor are compared.
+===================
+*/
+static inline const Marker *matchMarker(const Marker *markers, const quint32 *beginsWith, const uchar *p, const uchar *begin, const uchar *end)
+{
+    for (quint32 candidates = beginsWith[*p]; candidates; candidates &= candidates - 1)
+    {
+        const Marker &marker = markers[qCountTrailingZeroBits(candidates)];
+
+        if (end - p < marker.length || memcmp(p + 1, marker.text + 1, marker.length - 1))
+            continue;
+
+        if (marker.columnZero && (p != begin || isLetterOrNumberAt(p + marker.length, end)))
+            continue;
+
+        return &marker;
+    }
+
+    return nullptr;
+}
+
+/*
+===================
+countLine
+
+Follows the rules of the original per-character loop, but jumps
+straight to the next byte that can change the state of the line.
+===================
+*/
+template <Language::Type T>
+static void countLine(const uchar *begin, const uchar *end, const uchar *limit, bool &multiLineComment, MetricsData &data)
+{
+    constexpr const Syntax &syntax = syntaxOf<T>;
+
+    const uchar *p = begin;
+    cursorState state = (multiLineComment ? MultiLineComment : None);
+    bool isThereCommentLine = multiLineComment;
+    bool isThereCodeLine = false;
+    bool narrowLiteral = false;
+    bool previousLetter = false;
+
+    data.lines++;
+
+    // Blank line
+    if (isBlank(begin, end, limit))
+        data.blankLines++;
+
+    while (p < end)
+    {
+        if (state == None)
+        {
+            // Only comment markers and quotes can change the state, anything in between is code
+            const uchar *stop = findAny(p, end, limit, syntax.codeStops);
+
+            if (!isThereCodeLine && stop > p)
+                isThereCodeLine = hasPrintable(p, stop, limit);
+
+            p = stop;
+
+            if (p >= end)
+                break;
+
+            // Single comment or multiple comment - begin
+            if (const Marker *marker = matchMarker(syntax.start, syntax.startsWith, p, begin, end))
+            {
+                p += marker->length;
+                state = (marker->multiLine ? MultiLineComment : SingleLineComment);
+                isThereCommentLine = true;
+                previousLetter = isAsciiLetter(p[-1]);
+
+                if (p >= end)
+                    break;
+            }
+        }
+
+        if (state == MultiLineComment)
+        {
+            // Multiple comment - end
+            if (const Marker *marker = matchMarker(syntax.end, syntax.endsWith, p, begin, end))
+            {
+                p += marker->length;
+                state = None;
+                isThereCommentLine = true;
+
+                if (p >= end)
+                    break;
+            }
+            else
+            {
+                // Comment words up to the next byte that may end the comment
+                const uchar *stop = findAny(p + 1, end, limit, syntax.commentStops);
+                data.commentWords += countWords(p, stop, limit, previousLetter);
+                p = stop;
+                continue;
+            }
+        }
+
+        if (state == SingleLineComment)
+        {
+            data.commentWords += countWords(p, end, limit, previousLetter);
+            break;
+        }
+
+        uchar c = *p++;
+
+        // A line of code
+        if (c >= '!' && c <= '~') isThereCodeLine = true;
+
+        // String literal
+        if (state != CharacterLiteral && !narrowLiteral && c == '\"')
+            state = (state == StringLiteral ? None : StringLiteral);
+
+        // Character literal
+        if (state != StringLiteral && !narrowLiteral && c == '\'')
+            state = (state == CharacterLiteral ? None : CharacterLiteral);
+
+        // Escape Character
+        if (state == CharacterLiteral || state == StringLiteral)
+        {
+            narrowLiteral = (c == '\\' ? !narrowLiteral : false);
+
+            // Only quotes and backslashes matter inside of a literal
+            const uchar *stop = findAny(p, end, limit, state == StringLiteral ? stringStops : characterStops);
+
+            if (stop > p)
+                narrowLiteral = false;
+
+            p = stop;
+        }
+    }
+
+    if (isThereCommentLine)
+        data.commentLines++;
+
+    if (isThereCodeLine)
+        data.linesOfCode++;
+
+    multiLineComment = (state == MultiLineComment);
+}
+
+/*
+===================
+countLines
+
+Counts all complete lines and returns the beginning of an unfinished
+one, unless it's the last part of a file.
+===================
+*/
+template <Language::Type T>
+static const uchar *countLines(const uchar *begin, const uchar *end, bool last, bool &multiLineComment, MetricsData &data)
+{
+    while (begin < end)
+    {
+        const uchar *lineEnd = findNewline(begin, end);
+
+        if (lineEnd == end && !last)
+            break;
+
+        const uchar *next = (lineEnd < end ? lineEnd + 1 : end);
+
+        if (lineEnd > begin && lineEnd[-1] == '\r')
+            lineEnd--;
+
+        countLine<T>(begin, lineEnd, end, multiLineComment, data);
+        begin = next;
+    }
+
+    return begin;
+}
+
+/*
+===================
+getCountLines
+===================
+*/
+template <std::size_t... Types>
+static auto getCountLines(Language::Type type, std::index_sequence<Types...>)
+{
+    static constexpr decltype(&countLines<Language::Assembly>) countLinesList[] = {&countLines<static_cast<Language::Type>(Types)>...};
+    return countLinesList[type];
+}
+
+/*
+===================
+LineClassifier::LineClassifier
+===================
+*/
+LineClassifier::LineClassifier(Language::Type type) : countLines(getCountLines(type, std::make_index_sequence<Language::TypeCount>()))
+{
+}
+
+/*
+===================
+LineClassifier::countFile
+
+Maps the whole file, so the bytes are classified right where they are.
+Big files are mapped a window at a time and classified on all cores
+when there's more than one.
+Files that can't be mapped, like pipes, are read through a bounded
+buffer instead.
+===================
+*/
+bool LineClassifier::countFile(const QString &filename, MetricsData &data) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = file.size();
+
+    if (!file.isSequential() && size > PARALLEL_SIZE_LIMIT && QThread::idealThreadCount() > 1)
+    {
+        if (countParallel(file, size, data))
+            return true;
+    }
+    else if (!file.isSequential())
+    {
+        if (!size)
+            return true;
+
+        if (uchar *memory = file.map(0, size))
+        {
+            count(reinterpret_cast<const char *>(memory), size, data);
+            file.unmap(memory);
+            return true;
+        }
+    }
+
+    countBuffered(file, data);
+    return true;
+}
+
+/*
+===================
+LineClassifier::count
+===================
+*/
+void LineClassifier::count(const char *text, qint64 size, MetricsData &data) const
+{
+    const uchar *begin = reinterpret_cast<const uchar *>(text);
+    const uchar *end = begin + size;
+    bool multiLineComment = false;
+
+    // Files with a UTF-16 or UTF-32 byte order mark are decoded just like QTextStream would
+    std::optional<QStringConverter::Encoding> encoding = QStringConverter::encodingForData(QByteArrayView(text, size));
+
+    if (encoding && *encoding != QStringConverter::Utf8)
+    {
+        QStringDecoder decoder(*encoding);
+        QByteArray utf8 = QString(decoder(QByteArrayView(text, size))).toUtf8();
+
+        begin = reinterpret_cast<const uchar *>(utf8.constData());
+        countLines(begin, begin + utf8.size(), true, multiLineComment, data);
+        return;
+    }
+
+    // Skips the UTF-8 byte order mark
+    if (encoding)
+        begin += 3;
+
+    countLines(begin, end, true, multiLineComment, data);
+}
+
+/*
+===================
+LineClassifier::countParallel
+
+Maps the file a window at a time, starting every window at the line
+left unfinished by the previous one. Nothing is added to the metrics
+unless the whole file could be mapped, so that it can still be read
+some other way.
+===================
+*/
+bool LineClassifier::countParallel(QFile &file, qint64 size, MetricsData &data) const
+{
+    MetricsData fileData;
+    bool multiLineComment = false;
+    qint64 offset = 0;
+    qint64 windowSize = MAP_SIZE_LIMIT;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(QThread::idealThreadCount(), 1));
+
+    while (offset < size)
+    {
+        qint64 length = qMin(windowSize, size - offset);
+        bool last = (offset + length == size);
+
+        uchar *memory = file.map(offset, length);
+        if (!memory)
+            return false;
+
+        const uchar *begin = memory;
+
+        if (!offset)
+        {
+            std::optional<QStringConverter::Encoding> encoding = QStringConverter::encodingForData(QByteArrayView(reinterpret_cast<const char *>(memory), length));
+
+            // UTF-16 and UTF-32 have to be converted as a whole
+            if (encoding && *encoding != QStringConverter::Utf8)
+            {
+                file.unmap(memory);
+                return false;
+            }
+
+            if (encoding)
+                begin += 3;
+        }
+
+        const uchar *rest = countChunks(begin, memory + length, last, multiLineComment, fileData, pool);
+        qint64 used = rest - memory;
+        file.unmap(memory);
+
+        // A line longer than the whole window
+        if (!used && !last)
+        {
+            windowSize *= 2;
+            continue;
+        }
+
+        offset += used;
+
+        if (last)
+            break;
+    }
+
+    data += fileData;
+    return true;
+}
+
+/*
+===================
+LineClassifier::countChunks
+
+Splits the text at line ends into chunks, classified on the pool at the
+same time. The only state carried from one line to the next is whether
+a multi-line comment is open, which isn't known at the start of a chunk
+until the chunks before it have been classified. Chunks are classified
+speculatively as if no comment was open, and the results are chained
+together in order. Only if a chunk turns out to start inside a comment
+are it and the chunks after it classified again from inside one, so
+every chunk is classified at most twice, and the sum is always the
+same as classifying the whole text in one go.
+===================
+*/
+const uchar *LineClassifier::countChunks(const uchar *begin, const uchar *end, bool last, bool &multiLineComment, MetricsData &data, QThreadPool &pool) const
+{
+    struct Chunk
+    {
+        const uchar *begin;
+        const uchar *end;
+        bool complete;      // Ends with a complete line
+        bool counted[2] = {false, false};
+        const uchar *rest[2] = {nullptr, nullptr};
+        bool multiLineComment[2] = {false, true};
+        MetricsData data[2];
+    };
+
+    qint64 chunkCount = qMax<qint64>((end - begin) / CHUNK_SIZE, 1);
+    QList<Chunk> chunks;
+
+    for (qint64 i = 0; i < chunkCount && begin < end; i++)
+    {
+        const uchar *chunkEnd = end;
+
+        // Every chunk but the last ends right after a newline
+        if (i < chunkCount - 1)
+        {
+            chunkEnd = findNewline(begin + (end - begin) / (chunkCount - i), end);
+            chunkEnd = (chunkEnd < end ? chunkEnd + 1 : end);
+        }
+
+        chunks.append(Chunk{begin, chunkEnd, last || chunkEnd < end});
+        begin = chunkEnd;
+    }
+
+    auto classify = [this, &chunks, &pool](qsizetype from, int first, int others)
+    {
+        for (qsizetype i = from; i < chunks.size(); i++)
+        {
+            Chunk &chunk = chunks[i];
+            int entry = (i == from ? first : others);
+
+            if (chunk.counted[entry])
+                continue;
+
+            chunk.counted[entry] = true;
+
+            pool.start([this, &chunk, entry]()
+            {
+                chunk.rest[entry] = countLines(chunk.begin, chunk.end, chunk.complete, chunk.multiLineComment[entry], chunk.data[entry]);
+            });
+        }
+
+        pool.waitForDone();
+    };
+
+    // Only the first chunk starts in a known state
+    classify(0, multiLineComment, 0);
+
+    const uchar *rest = begin;
+
+    for (qsizetype i = 0; i < chunks.size(); i++)
+    {
+        int entry = multiLineComment;
+
+        // A wrong guess, likely in a long comment, so the chunks after it are tried in one too
+        if (!chunks[i].counted[entry])
+            classify(i, entry, 1);
+
+        data += chunks[i].data[entry];
+        multiLineComment = chunks[i].multiLineComment[entry];
+        rest = chunks[i].rest[entry];
+    }
+
+    return rest;
+}
+
+/*
+===================
+LineClassifier::countBuffered
+===================
+*/
+void LineClassifier::countBuffered(QFile &file, MetricsData &data) const
+{
+    QByteArray buffer(READ_BUFFER_SIZE, Qt::Uninitialized);
+    qint64 used = 0;
+    bool multiLineComment = false;
+    bool checkedEncoding = false;
+
+    forever
+    {
+        qint64 bytesRead = file.read(buffer.data() + used, buffer.size() - used);
+        bool last = (bytesRead <= 0);
+        used += qMax<qint64>(bytesRead, 0);
+
+        const uchar *begin = reinterpret_cast<const uchar *>(buffer.constData());
+        const uchar *end = begin + used;
+
+        // Waits for enough bytes to look for a byte order mark
+        if (!checkedEncoding)
+        {
+            if (used < 4 && !last)
+                continue;
+
+            std::optional<QStringConverter::Encoding> encoding = QStringConverter::encodingForData(QByteArrayView(buffer.constData(), used));
+            checkedEncoding = true;
+
+            // There's no point in streaming files that have to be converted anyway
+            if (encoding && *encoding != QStringConverter::Utf8)
+            {
+                buffer.truncate(used);
+                buffer.append(file.readAll());
+                count(buffer.constData(), buffer.size(), data);
+                return;
+            }
+
+            if (encoding)
+                begin += 3;
+        }
+
+        const uchar *rest = countLines(begin, end, last, multiLineComment, data);
+
+        if (last)
+            return;
+
+        // Moves an unfinished line to the front and grows the buffer only if the line fills all of it
+        used = end - rest;
+        memmove(buffer.data(), rest, used);
+
+        if (used == buffer.size())
+            buffer.resize(buffer.size() * 2);
+    }
+}
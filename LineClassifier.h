@@ -0,0 +1,70 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef LINECLASSIFIER_H
+#define LINECLASSIFIER_H
+
+#include "Language.h"
+
+// Files are mapped at most this much at a time
+#define MAP_SIZE_LIMIT (Q_INT64_C(256) << 20)
+
+// Files bigger than this are split into chunks classified in parallel
+#define PARALLEL_SIZE_LIMIT (Q_INT64_C(32) << 20)
+#define CHUNK_SIZE (Q_INT64_C(8) << 20)
+
+class QFile;
+class QThreadPool;
+
+/*
+===========================================================
+
+    LineClassifier
+
+    Splits a source file into lines and classifies each of them
+    as code, comment or blank according to its language rules.
+    Works on raw UTF-8 bytes and skips over runs of bytes that
+    can't change the state of a line with SSE2/AVX2 when available.
+    The line loop is compiled separately for every language, so
+    its comment markers are constants. Very large files are split
+    into chunks classified in parallel.
+
+===========================================================
+*/
+class LineClassifier
+{
+public:
+
+    explicit LineClassifier(Language::Type type);
+
+    bool countFile(const QString &filename, MetricsData &data) const;
+    void count(const char *text, qint64 size, MetricsData &data) const;
+
+private:
+
+    typedef const uchar *(*CountLinesFunction)(const uchar *begin, const uchar *end, bool last, bool &multiLineComment, MetricsData &data);
+
+    void countBuffered(QFile &file, MetricsData &data) const;
+    bool countParallel(QFile &file, qint64 size, MetricsData &data) const;
+    const uchar *countChunks(const uchar *begin, const uchar *end, bool last, bool &multiLineComment, MetricsData &data, QThreadPool &pool) const;
+
+    CountLinesFunction countLines;
+};
+
+#endif // LINECLASSIFIER_H
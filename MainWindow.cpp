@@ -17,56 +17,38 @@
 ===============================================================================
 */
 
-#include <QFile>
-#include <QDirIterator>
-#include <QTextStream>
+#include <QDockWidget>
 #include <QFileIconProvider>
+#include <QFontDatabase>
+#include <QInputDialog>
+#include <QMenu>
+#include <QPlainTextEdit>
 #include <QStringListModel>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QCloseEvent>
+#include <QTimer>
 
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
 #include "DirsFirstProxyModel.h"
 #include "FileSelectorModel.h"
 #include "ProjectsList.h"
+#include "Counter.h"
+#include "Profiler.h"
+#include "Watcher.h"
 
 #define NUMBER_OF_METRICS 7
+#define METRICS_UPDATE_INTERVAL 33 // About 30 times per second
 
-Language langList[Language::TypeCount] = {
-{ Language::Assembly,    "Assembly",       {"//", ";", "#"},   {"/*"},                 {"*/"},                 {"asm", "nasm", "s"}},
-{ Language::Basic,       "BASIC",          {"'", "REM"},       {},                     {},                     {"bas", "vb"}},
-{ Language::C,           "C",              {"//"},             {"/*"},                 {"*/"},                 {"c"}},
-{ Language::CSharp,      "C#",             {"//"},             {"/*"},                 {"*/"},                 {"cs"}},
-{ Language::CPP,         "C++",            {"//"},             {"/*"},                 {"*/"},                 {"cpp", "cc", "cxx", "c++", "inl", "ipp"}},
-{ Language::CHeader,     "C/C++ Header",   {"//"},             {"/*"},                 {"*/"},                 {"h", "hh", "hpp", "h++", "hpp", "hxx"}},
-{ Language::Clojure,     "Clojure",        {";"},              {},                     {},                     {"clj", "cljs", "cljc", "edn"}},
-{ Language::CoffeeScript,"CoffeeScript",   {"#"},              {"###"},                {"###"},                {"coffee", "litcoffee"}},
-{ Language::D,           "D",              {"//"},             {"/*", "/+"},           {"*/", "+/"},           {"d"}},
-{ Language::FSharp,      "F#",             {"//"},             {"/*", "(*"},           {"*/", "*)"},           {"fs" "fsx"}},
-{ Language::GLSL,        "GLSL",           {"//"},             {"/*"},                 {"*/"},                 {"vert", "tesc", "tese", "geom", "frag", "comp", "glsl", "glslv"}},
-{ Language::Go,          "Go",             {"//"},             {"/*"},                 {"*/"},                 {"go"}},
-{ Language::Groovy,      "Groovy",         {"//"},             {"/*"},                 {"*/"},                 {"groovy", "gvy", "gy", "gsh"}},
-{ Language::Haskell,     "Haskell",        {"--"},             {"{-"},                 {"-}"},                 {"hs", "lhs"}},
-{ Language::HLSL,        "HLSL",           {"//"},             {"/*"},                 {"*/"},                 {"hlsl"}},
-{ Language::Java,        "Java",           {"//"},             {"/*"},                 {"*/"},                 {"java"}},
-{ Language::JavaScript,  "JavaScript",     {"//"},             {"/*"},                 {"*/"},                 {"js", "json"}},
-{ Language::Kotlin,      "Kotlin",         {"//"},             {"/*"},                 {"*/"},                 {"kt", "kts"}},
-{ Language::Lisp,        "Lisp",           {"//"},             {"#|"},                 {"|#"},                 {"lisp"}},
-{ Language::Lua,         "Lua",            {"--"},             {"/*", "--[["},         {"*/", "]]"},           {"lua"}},
-{ Language::ObjectC,     "Object-C",       {"//"},             {"/*"},                 {"*/"},                 {"m", "mm"}},
-{ Language::PERL,        "Perl",           {"#"},              {},                     {},                     {"pl", "pm", "perl", "t", "pod"}},
-{ Language::Pascal,      "Pascal",         {"//"},             {"(*", "{"},            {"*)", "}"},            {"pas", "p"}},
-{ Language::PHP,         "PHP",            {"#"},              {"/*"},                 {"*/"},                 {"php", "phtml", "php3", "php4", "php5", "phps"}},
-{ Language::Python,      "Python",         {"#"},              {"\"\"\"", "\'\'\'"},   {"\"\"\"", "\'\'\'"},   {"py"}},
-{ Language::R,           "R",              {"#"},              {},                     {},                     {"r"}},
-{ Language::Ruby,        "Ruby",           {"#"},              {"=begin"},             {"=end"},               {"rb", "rbw"}},
-{ Language::Rust,        "Rust",           {"//"},             {"/*"},                 {"*/"},                 {"rs"}},
-{ Language::Scala,       "Scala",          {"//"},             {"/*"},                 {"*/"},                 {"scala"}},
-{ Language::SQL,         "SQL",            {"#", "--"},        {"/*"},                 {"*/"},                 {"sql"}},
-{ Language::Swift,       "Swift",          {"//"},             {"/*"},                 {"*/"},                 {"swift"}},
-{ Language::TypeScript,  "TypeScript",     {"//"},             {"/*"},                 {"*/"},                 {"ts", "tsx"}}};
+// Metrics in the order of the table columns, after the language name
+static int MetricsData::*const metricsColumns[NUMBER_OF_METRICS - 1] = {
+    &MetricsData::sourceFiles,
+    &MetricsData::lines,
+    &MetricsData::linesOfCode,
+    &MetricsData::commentLines,
+    &MetricsData::commentWords,
+    &MetricsData::blankLines};
 
 /*
 ===================
@@ -121,6 +103,50 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 
     ui->metricsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
 
+    fileCache.load(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + CACHE_FILENAME);
+    fileCache.setHashing(settings.value("CacheHashing", false).toBool());
+
+    // Metrics of older versions are imported once
+    if (!metricsStore.load(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + METRICS_FILENAME))
+        metricsStore.migrate(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + LEGACY_METRICS_FILENAME);
+
+    counter = new Counter(this);
+    counter->setCache(&fileCache);
+    counter->setDuplicates(settings.value("CountCopiesOnce", false).toBool() ? Counter::CountOnce : Counter::CountEveryCopy,
+                           settings.value("CompareContents", false).toBool());
+    counter->setUringDepth(settings.value("UringQueueDepth", 0).toInt());
+
+    // Keeps the metrics of the last count current as files change
+    watcher = new Watcher(this);
+
+    // Metrics are pulled from the counter at a steady rate, however fast files are counted
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(METRICS_UPDATE_INTERVAL);
+
+    // Time spent in every stage of the last count, shown once it's done
+    profileText = new QPlainTextEdit;
+    profileText->setReadOnly(true);
+    profileText->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    profileDock = new QDockWidget("Profile", this);
+    profileDock->setWidget(profileText);
+    addDockWidget(Qt::BottomDockWidgetArea, profileDock);
+    profileDock->hide();
+
+    profilingAction = new QAction("Profile Counting", this);
+    profilingAction->setShortcut(QKeySequence(Qt::Key_F12));
+    profilingAction->setCheckable(true);
+    addAction(profilingAction);
+
+    watchAction = new QAction("Watch for Changes", this);
+    watchAction->setShortcut(QKeySequence(Qt::Key_F9));
+    watchAction->setCheckable(true);
+    addAction(watchAction);
+
+    countAllAction = new QAction("Count All Projects", this);
+    countAllAction->setShortcut(QKeySequence(Qt::Key_F6));
+    addAction(countAllAction);
+
     for (int i = 0; i < Language::TypeCount + 1; i++)
     {
         QTableWidgetItem *item = new QTableWidgetItem();
@@ -149,11 +175,24 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
         }
     }
 
+    updateMetricsTableRows();
+
     QSettings projects(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + PROJECTS_FILENAME, QSettings::IniFormat);
     projectNames = projects.allKeys();
     for (auto &name : projectNames) projectPathList.push_back(projects.value(name).toStringList());
     projectsListModel->setStringList(projectNames);
 
+    QSettings ignore(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + IGNORE_FILENAME, QSettings::IniFormat);
+
+    for (auto &name : projectNames)
+    {
+        ignore.beginGroup(name);
+        projectIgnoreList.push_back(IgnoreSettings{ignore.value("Patterns").toStringList(), ignore.value("IgnoreFiles", false).toBool()});
+        ignore.endGroup();
+    }
+
+    ui->projectsList->setContextMenuPolicy(Qt::CustomContextMenu);
+
 // Fixes missing horizontal borders in headers on Windows
 #ifdef Q_OS_WIN
     ui->fileSelector->header()->setStyleSheet("QHeaderView::section {"
@@ -172,12 +211,22 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     connect(ui->addButton, SIGNAL(clicked()), SLOT(addProject()));
     connect(ui->removeButton, SIGNAL(clicked()), SLOT(removeProject()));
     connect(ui->countButton, SIGNAL(clicked()), SLOT(count()));
+    connect(progressTimer, SIGNAL(timeout()), SLOT(countProgress()));
+    connect(profilingAction, SIGNAL(toggled(bool)), SLOT(setProfiling(bool)));
+    connect(watchAction, SIGNAL(toggled(bool)), SLOT(setWatching(bool)));
+    connect(countAllAction, SIGNAL(triggered()), SLOT(countAll()));
+    connect(counter, SIGNAL(finished()), SLOT(countFinished()));
+    connect(watcher, SIGNAL(changed()), SLOT(watchChanged()));
     connect(ui->metricsTable->horizontalHeader(), SIGNAL(sectionClicked(int)), SLOT(sort(int)));
     connect(ui->projectsList->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), SLOT(projectClicked(QItemSelection,QItemSelection)));
     connect(ui->projectsList->model(), SIGNAL(dataChanged(QModelIndex,QModelIndex,QList<int>)), SLOT(projectNameChanged(QModelIndex)));
     connect(ui->projectsList, SIGNAL(deletePressed()), SLOT(removeProject()));
+    connect(ui->projectsList, SIGNAL(customContextMenuRequested(QPoint)), SLOT(showProjectMenu(QPoint)));
     connect(fileSelectorModel, SIGNAL(directoryLoaded(QString)), SLOT(scrollToCenter()));
     connect(ui->fileSelector, &QTreeView::expanded, this, [this](){ scrollable = false; });
+
+    profilingAction->setChecked(settings.value("Profiling", false).toBool());
+    watchAction->setChecked(settings.value("Watch", false).toBool());
 }
 
 /*
@@ -187,6 +236,16 @@ MainWindow::~MainWindow
 */
 MainWindow::~MainWindow()
 {
+    counter->stop();
+    counter->wait();
+
+    // Files that changed while watching are kept for the next count
+    if (watcher->isWatching())
+    {
+        watcher->stop();
+        fileCache.save(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + CACHE_FILENAME);
+    }
+
     QSettings settings(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + SETTINGS_FILENAME, QSettings::IniFormat);
     QVariantList hSizes, vSizes;
 
@@ -199,6 +258,12 @@ MainWindow::~MainWindow()
     settings.setValue("HorizontalSplitter", hSizes);
     settings.setValue("VerticalSplitter", vSizes);
     settings.setValue("Fullscreen", isMaximized());
+    settings.setValue("CacheHashing", fileCache.isHashing());
+    settings.setValue("CountCopiesOnce", counter->getDuplicateMode() == Counter::CountOnce);
+    settings.setValue("CompareContents", counter->isComparingContents());
+    settings.setValue("UringQueueDepth", counter->getUringDepth());
+    settings.setValue("Profiling", profilingAction->isChecked());
+    settings.setValue("Watch", watchAction->isChecked());
 
     if (!isMaximized())
     {
@@ -219,6 +284,20 @@ MainWindow::~MainWindow()
     for (int i = 0; i < projectNames.size(); i++)
         projects.setValue(projectNames[i], projectPathList[i]);
 
+    QSettings ignore(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + IGNORE_FILENAME, QSettings::IniFormat);
+    ignore.clear();
+
+    for (int i = 0; i < projectNames.size(); i++)
+    {
+        if (projectIgnoreList[i].patterns.isEmpty() && !projectIgnoreList[i].ignoreFiles)
+            continue;
+
+        ignore.beginGroup(projectNames[i]);
+        ignore.setValue("Patterns", projectIgnoreList[i].patterns);
+        ignore.setValue("IgnoreFiles", projectIgnoreList[i].ignoreFiles);
+        ignore.endGroup();
+    }
+
     delete ui;
 }
 
@@ -242,6 +321,7 @@ void MainWindow::addProject()
 
     projectNames.push_back(newName);
     projectPathList.push_back(pathList);
+    projectIgnoreList.push_back(IgnoreSettings());
     projectsListModel->setStringList(projectNames);
 
     // Prevents reloading of newly added projects, as they're already loaded
@@ -262,30 +342,19 @@ void MainWindow::removeProject()
 
     for (auto &index : ui->projectsList->selectionModel()->selectedIndexes())
     {
-        QSettings metricsData(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + METRICS_FILENAME, QSettings::IniFormat);
         int currentRow = index.row();
 
         ui->projectsList->model()->removeRow(currentRow);
 
         // Removes project metrics
-        for (int i = 0; i < Language::TypeCount; i++)
-        {
-            QString langName(langList[i].name);
-            langName.replace('/', ' ');
-
-            metricsData.remove(QString("%1-%2-SourceFiles").arg(projectNames[currentRow], langName));
-            metricsData.remove(QString("%1-%2-Lines").arg(projectNames[currentRow], langName));
-            metricsData.remove(QString("%1-%2-LinesOfCode").arg(projectNames[currentRow], langName));
-            metricsData.remove(QString("%1-%2-CommentLines").arg(projectNames[currentRow], langName));
-            metricsData.remove(QString("%1-%2-CommentWords").arg(projectNames[currentRow], langName));
-            metricsData.remove(QString("%1-%2-BlankLines").arg(projectNames[currentRow], langName));
-        }
+        metricsStore.remove(projectNames[currentRow]);
 
         projectNames.removeAt(currentRow);
         projectPathList.removeAt(currentRow);
+        projectIgnoreList.removeAt(currentRow);
     }
 
-    fileSelectorModel->setData(fileSelectorModel->index(0, 0, QModelIndex()), Qt::Unchecked, Qt::CheckStateRole);
+    fileSelectorModel->setChecked(QStringList());
     ui->fileSelector->collapseAll();
     ui->projectsList->selectionModel()->reset();
 }
@@ -302,8 +371,7 @@ void MainWindow::projectClicked(const QItemSelection &selected, const QItemSelec
     // Resets the selector when clicking on an empty area
     if (selected.indexes().isEmpty())
     {
-        for (int i = 0; i < fileSelectorModel->rowCount(); i++)
-            fileSelectorModel->setData(fileSelectorModel->index(i, 0, QModelIndex()), Qt::Unchecked, Qt::CheckStateRole);
+        fileSelectorModel->setChecked(QStringList());
 
         return;
     }
@@ -353,50 +421,48 @@ void MainWindow::projectNameChanged(const QModelIndex &index)
         return;
     }
 
-    QSettings metricsData(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + METRICS_FILENAME, QSettings::IniFormat);
-
     // Saves metrics data under a new project name
-    for (int i = 0; i < Language::TypeCount; i++)
-    {
-        MetricsData data;
-
-        QString langName(langList[i].name);
-        langName.replace('/', ' ');
-
-        data.sourceFiles = metricsData.value(QString("%1-%2-SourceFiles").arg(projectNames[row], langName), -1).toInt();
-        data.lines = metricsData.value(QString("%1-%2-Lines").arg(projectNames[row], langName), -1).toInt();
-        data.linesOfCode = metricsData.value(QString("%1-%2-LinesOfCode").arg(projectNames[row], langName), -1).toInt();
-        data.commentLines = metricsData.value(QString("%1-%2-CommentLines").arg(projectNames[row], langName), -1).toInt();
-        data.commentWords = metricsData.value(QString("%1-%2-CommentWords").arg(projectNames[row], langName), -1).toInt();
-        data.blankLines = metricsData.value(QString("%1-%2-BlankLines").arg(projectNames[row], langName), -1).toInt();
+    metricsStore.rename(projectNames[row], newName);
 
-        if (data.sourceFiles >= 0)
-            metricsData.setValue(QString("%1-%2-SourceFiles").arg(newName, langName), data.sourceFiles);
-
-        if (data.lines >= 0)
-            metricsData.setValue(QString("%1-%2-Lines").arg(newName, langName), data.lines);
+    projectNames[row] = newName;
+}
 
-        if (data.linesOfCode >= 0)
-            metricsData.setValue(QString("%1-%2-LinesOfCode").arg(newName, langName), data.linesOfCode);
+/*
+===================
+MainWindow::showProjectMenu
+===================
+*/
+void MainWindow::showProjectMenu(const QPoint &pos)
+{
+    QModelIndex index = ui->projectsList->indexAt(pos);
 
-        if (data.commentLines >= 0)
-            metricsData.setValue(QString("%1-%2-CommentLines").arg(newName, langName), data.commentLines);
+    if (!index.isValid() || counting)
+        return;
 
-        if (data.commentWords >= 0)
-            metricsData.setValue(QString("%1-%2-CommentWords").arg(newName, langName), data.commentWords);
+    IgnoreSettings &settings = projectIgnoreList[index.row()];
+    QMenu menu(this);
+    QAction *patternsAction = menu.addAction("Ignore Patterns...");
+    QAction *ignoreFilesAction = menu.addAction("Use .gitignore Files");
+    ignoreFilesAction->setCheckable(true);
+    ignoreFilesAction->setChecked(settings.ignoreFiles);
+    menu.addSeparator();
+    menu.addAction(countAllAction);
 
-        if (data.blankLines >= 0)
-            metricsData.setValue(QString("%1-%2-BlankLines").arg(newName, langName), data.blankLines);
+    QAction *action = menu.exec(ui->projectsList->viewport()->mapToGlobal(pos));
 
-        metricsData.remove(QString("%1-%2-SourceFiles").arg(projectNames[row], langName));
-        metricsData.remove(QString("%1-%2-Lines").arg(projectNames[row], langName));
-        metricsData.remove(QString("%1-%2-LinesOfCode").arg(projectNames[row], langName));
-        metricsData.remove(QString("%1-%2-CommentLines").arg(projectNames[row], langName));
-        metricsData.remove(QString("%1-%2-CommentWords").arg(projectNames[row], langName));
-        metricsData.remove(QString("%1-%2-BlankLines").arg(projectNames[row], langName));
+    if (action == ignoreFilesAction)
+    {
+        settings.ignoreFiles = ignoreFilesAction->isChecked();
     }
+    else if (action == patternsAction)
+    {
+        bool ok;
+        QString text = QInputDialog::getMultiLineText(this, "Ignore Patterns", "Files and directories to skip, one pattern per line, as in .gitignore files:",
+                                                      settings.patterns.join('\n'), &ok);
 
-    projectNames[row] = newName;
+        if (ok)
+            settings.patterns = text.split('\n', Qt::SkipEmptyParts);
+    }
 }
 
 /*
@@ -408,261 +474,237 @@ void MainWindow::count()
 {
     if (counting)
     {
-        counting = false;
+        counter->stop();
         canUpdateDiff = false;
         return;
     }
 
-    // Widgets are off
-    ui->projectsList->setEnabled(false);
-    ui->fileSelector->setEnabled(false);
-    ui->addButton->setEnabled(false);
-    ui->removeButton->setEnabled(false);
-    ui->countButton->setText("Stop");
-    counting = true;
+    startCounting();
 
-    // Resets all metrics data
-    ui->progressBar->setValue(0);
-    memset(&dataCurrent, 0, sizeof(MetricsData) * Language::TypeCount);
+    QList<QString> pathList;
+    fileSelectorModel->getPathList(pathList);
 
-    for (int i = 0; i < ui->metricsTable->rowCount(); i++)
-    {
-        ui->metricsTable->hideRow(i);
+    if (ui->projectsList->selectionModel()->isSelected(ui->projectsList->currentIndex()))
+        countedIgnore = projectIgnoreList[ui->projectsList->currentIndex().row()];
+    else
+        countedIgnore = IgnoreSettings();
 
-        for (int j = 1; j < ui->metricsTable->columnCount(); j++)
-        {
-            ui->metricsTable->item(i, j)->setText(QString());
+    countedPaths = pathList;
+    counter->setIgnore(countedIgnore.patterns, countedIgnore.ignoreFiles);
+    counter->setGroups(QList<QStringList>());
+    counter->start(pathList);
+    progressTimer->start();
+}
 
-            if (i != Language::TypeCount)
-                ui->metricsTable->item(i, j)->setBackground(QBrush(QColor("White")));
-        }
-    }
+/*
+===================
+MainWindow::countAll
+
+Counts every saved project in one go. Projects with the same ignore
+settings are counted together, over all of their paths at once, so a
+file in several of them is read and classified only once and added to
+each of them. Projects with other settings, or with a path inside a path
+of another project, are counted in another run that shares the cache, so
+every project is walked from its own paths with its own rules.
+===================
+*/
+void MainWindow::countAll()
+{
+    if (counting)
+        return;
 
-    ui->progressBar->setFormat("Counting files...");
+    // The path list of the selected project is only saved once another one is selected
+    if (ui->projectsList->selectionModel()->isSelected(ui->projectsList->currentIndex()))
+        fileSelectorModel->getPathList(projectPathList[ui->projectsList->currentIndex().row()]);
 
-    MetricsData dataTotal;
-    QList<SourceFile> filesList;
-    QList<QString> pathList;
-    fileSelectorModel->getPathList(pathList);
+    QList<BatchRun> settingsRuns;
+    batchRuns.clear();
+    batchSnapshots.clear();
 
-    // Counts files
-    for (auto &path : pathList)
+    for (int i = 0; i < projectNames.size(); i++)
     {
-        QFileInfo fileInfo(path);
-
-        if (!fileInfo.exists())
+        if (projectPathList[i].isEmpty())
             continue;
 
-        if (!counting)
-            break;
+        const IgnoreSettings &settings = projectIgnoreList[i];
+        int run = 0;
 
-        if (fileInfo.isFile())
-        {
-            addPath(dataTotal, filesList, path, fileInfo.completeSuffix());
-        }
-        else if (fileInfo.isDir())
+        while (run < settingsRuns.size() && (settingsRuns[run].ignore.patterns != settings.patterns || settingsRuns[run].ignore.ignoreFiles != settings.ignoreFiles))
+            run++;
+
+        if (run == settingsRuns.size())
+            settingsRuns.append(BatchRun{settings, QList<int>()});
+
+        settingsRuns[run].projects.append(i);
+    }
+
+    for (auto &run : settingsRuns)
+    {
+        QList<QStringList> pathLists;
+
+        for (int project : run.projects)
+            pathLists.append(projectPathList[project]);
+
+        for (auto &set : Counter::splitGroups(pathLists))
         {
-            QDirIterator sourceDirectory(path, QDir::Dirs | QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            BatchRun splitRun{run.ignore, QList<int>()};
 
-            while (sourceDirectory.hasNext() && counting)
-            {
-                sourceDirectory.next();
+            for (int group : set)
+                splitRun.projects.append(run.projects[group]);
 
-                if(sourceDirectory.fileInfo().isFile())
-                    addPath(dataTotal, filesList, sourceDirectory.fileInfo().filePath(), sourceDirectory.fileInfo().completeSuffix());
-            }
+            batchRuns.append(splitRun);
         }
     }
 
-    ui->progressBar->setFormat("%p%");
+    if (batchRuns.isEmpty())
+        return;
+
+    startCounting();
+    startBatchRun();
+}
+
+/*
+===================
+MainWindow::startCounting
+===================
+*/
+void MainWindow::startCounting()
+{
+    // The cache is the counter's until it's done
+    watcher->stop();
+
+    // Widgets are off
+    ui->projectsList->setEnabled(false);
+    ui->fileSelector->setEnabled(false);
+    ui->addButton->setEnabled(false);
+    ui->removeButton->setEnabled(false);
+    ui->countButton->setText("Stop");
+    counting = true;
+
+    ui->progressBar->setValue(0);
+    clearMetricsTable();
+    ui->progressBar->setFormat("Counting files...");
+
+    if (Profiler::isEnabled())
+        Profiler::reset();
+}
 
-    // Counts source lines
-    for (int i = 0, files = 0; i < filesList.size() && counting; i++)
+/*
+===================
+MainWindow::startBatchRun
+===================
+*/
+void MainWindow::startBatchRun()
+{
+    const BatchRun &run = batchRuns.first();
+    QList<QStringList> pathLists;
+    QStringList pathList;
+
+    for (int project : run.projects)
     {
-        Language::Type langType = filesList[i].langType;
+        pathLists.append(projectPathList[project]);
+        pathList.append(projectPathList[project]);
+    }
 
-        if (langType != Language::None)
-        {
-            QFile file(filesList[i].filename);
-            file.open(QIODevice::ReadOnly);
-            if (!file.isOpen())
-                continue;
+    counter->setIgnore(run.ignore.patterns, run.ignore.ignoreFiles);
+    counter->setGroups(pathLists);
+    counter->start(pathList);
+    progressTimer->start();
+}
 
-            QTextStream in(&file);
-            cursorState cursorState = None;
+/*
+===================
+MainWindow::countProgress
+===================
+*/
+void MainWindow::countProgress()
+{
+    if (!counting)
+        return;
 
-            // Reads a file
-            while (!in.atEnd())
-            {
-                bool isThereCommentLine = (cursorState == MultiLineComment ? true : false);
-                bool isThereCodeLine = false;
-                bool narrowLiteral = false;
-
-                QString line = in.readLine();
-                cursorState = isThereCommentLine ? MultiLineComment : None;
-
-                dataCurrent[langType].lines++;
-                dataTotal.lines++;
-
-                // Blank line
-                if (line.simplified().isEmpty())
-                {
-                    dataCurrent[langType].blankLines++;
-                    dataTotal.blankLines++;
-                }
-
-                // Reads a line
-                for (int j = 0; j < line.length(); j++)
-                {
-                    if (cursorState == None)
-                    {
-                        for (int k = 0; langList[langType].singleComment[k] || langList[langType].multipleCommentStart[k]; k++)
-                        {
-                            // Single Comment
-                            if (langList[langType].singleComment[k] && checkForKeyword(line, j, langList[langType].singleComment[k]))
-                            {
-                                j += strlen(langList[langType].singleComment[k]);
-                                cursorState = SingleLineComment;
-                                isThereCommentLine = true;
-                                break;
-                            }
-
-                            // Multiple comment - begin
-                            if (langList[langType].multipleCommentStart[k] && checkForKeyword(line, j, langList[langType].multipleCommentStart[k]) && (langType != Language::Ruby || (j == 0 && !line[j + strlen(langList[langType].multipleCommentStart[k])].isLetterOrNumber())))
-                            {
-                                j += strlen(langList[langType].multipleCommentStart[k]);
-                                cursorState = MultiLineComment;
-                                isThereCommentLine = true;
-                                break;
-                            }
-                        }
-
-                        if (j >= line.length()) break;
-                    }
-
-                    // Multiple comment - end
-                    if (cursorState == MultiLineComment)
-                    {
-                        for (int k = 0; langList[langType].multipleCommentEnd[k]; k++)
-                        {
-                            if (checkForKeyword(line, j, langList[langType].multipleCommentEnd[k]) && (langType != Language::Ruby || (j == 0 && !line[j + strlen(langList[langType].multipleCommentEnd[k])].isLetterOrNumber())))
-                            {
-                                j += strlen(langList[langType].multipleCommentEnd[k]);
-                                cursorState = None;
-                                isThereCommentLine = true;
-                                break;
-                            }
-                        }
-
-                        if (j >= line.length()) break;
-                    }
-
-                    // Comment words
-                    if ((cursorState == SingleLineComment || cursorState == MultiLineComment) && ((j == 0 && line[j].isLetter()) || (j > 0 && !line[j - 1].isLetter() && line[j].isLetter())))
-                    {
-                        dataCurrent[langType].commentWords++;
-                        dataTotal.commentWords++;
-                    }
-
-                    if (cursorState != SingleLineComment && cursorState != MultiLineComment)
-                    {
-                        // A line of code
-                        if (line[j] >= '!' && line[j] <= '~') isThereCodeLine = true;
-
-                        // String literal
-                        if (cursorState != CharacterLiteral && !narrowLiteral && checkForKeyword(line, j, "\""))
-                            cursorState = (cursorState == StringLiteral ? None : StringLiteral);
-
-                        // Character literal
-                        if (cursorState != StringLiteral && !narrowLiteral && checkForKeyword(line, j, "\'"))
-                            cursorState = (cursorState == CharacterLiteral ? None : CharacterLiteral);
-
-                        // Escape Character
-                        if (cursorState == CharacterLiteral || cursorState == StringLiteral)
-                        {
-                            if (checkForKeyword(line, j, "\\"))
-                                narrowLiteral = !narrowLiteral;
-                            else
-                                narrowLiteral = false;
-                        }
-                    }
-                }
-
-                if (isThereCommentLine)
-                {
-                    dataCurrent[langType].commentLines++;
-                    dataTotal.commentLines++;
-                }
-
-                if (isThereCodeLine)
-                {
-                    dataCurrent[langType].linesOfCode++;
-                    dataTotal.linesOfCode++;
-                }
-            }
+    PROFILE_SCOPE("Update UI");
+
+    int files, total;
+    counter->getProgress(files, total);
+
+    if (total)
+    {
+        ui->progressBar->setFormat("%p%");
+        ui->progressBar->setValue((float) files / total * 100);
+    }
+
+    counter->getMetrics(dataCurrent);
+    updateMetricsTable();
+}
 
-            file.close();
+/*
+===================
+MainWindow::countFinished
+===================
+*/
+void MainWindow::countFinished()
+{
+    progressTimer->stop();
+    counter->wait();
+    counter->getMetrics(dataCurrent);
 
-            files++;
-            ui->progressBar->setValue((float) files / filesList.size() * 100);
+    bool batch = !batchRuns.isEmpty();
 
-            int row = getMetricsTableIndex(langType);
+    if (batch && !counter->isStopped())
+    {
+        BatchRun run = batchRuns.takeFirst();
 
-            ui->metricsTable->item(row, 2)->setData(Qt::EditRole, dataCurrent[langType].lines);
-            ui->metricsTable->item(row, 3)->setData(Qt::EditRole, dataCurrent[langType].linesOfCode);
-            ui->metricsTable->item(row, 4)->setData(Qt::EditRole, dataCurrent[langType].commentLines);
-            ui->metricsTable->item(row, 5)->setData(Qt::EditRole, dataCurrent[langType].commentWords);
-            ui->metricsTable->item(row, 6)->setData(Qt::EditRole, dataCurrent[langType].blankLines);
+        for (int i = 0; i < run.projects.size(); i++)
+            counter->getGroupMetrics(i, batchSnapshots[projectNames[run.projects[i]]].data);
 
-            ui->metricsTable->item(Language::TypeCount, 2)->setData(Qt::EditRole, dataTotal.lines);
-            ui->metricsTable->item(Language::TypeCount, 3)->setData(Qt::EditRole, dataTotal.linesOfCode);
-            ui->metricsTable->item(Language::TypeCount, 4)->setData(Qt::EditRole, dataTotal.commentLines);
-            ui->metricsTable->item(Language::TypeCount, 5)->setData(Qt::EditRole, dataTotal.commentWords);
-            ui->metricsTable->item(Language::TypeCount, 6)->setData(Qt::EditRole, dataTotal.blankLines);
+        if (!batchRuns.isEmpty())
+        {
+            startBatchRun();
+            return;
         }
+    }
+
+    batchRuns.clear();
+    updateMetricsTable();
+
+    fileCache.save(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + CACHE_FILENAME);
+
+    if (Profiler::isEnabled())
+    {
+        QString traceFilename = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + TRACE_FILENAME;
+        bool written = Profiler::writeTrace(traceFilename);
 
-        QApplication::processEvents();
+        profileText->setPlainText(Profiler::summary() + (written ? "\nTrace: " + traceFilename : QString()));
+        profileDock->show();
     }
 
-    if (counting)
+    if (!counter->isStopped() && batch)
+    {
+        finishBatch();
+    }
+    else if (!counter->isStopped())
     {
         if (ui->projectsList->selectionModel()->isSelected(ui->projectsList->currentIndex()))
         {
-            QSettings metricsData(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + METRICS_FILENAME, QSettings::IniFormat);
             int currentRow = ui->projectsList->currentIndex().row();
+            const MetricsSnapshot *previous = metricsStore.latest(projectNames[currentRow]);
 
             // Updates previous metrics with new data
-            for (int i = 0; i < Language::TypeCount; i++)
-            {
-                QString langName(langList[i].name);
-
-                // Removes backslashes, as QSettings interprets them as special characters
-                langName.replace('/', ' ');
-
-                dataPrevious[i].sourceFiles = metricsData.value(QString("%1-%2-SourceFiles").arg(projectNames[currentRow], langName), dataCurrent[i].sourceFiles).toInt();
-                dataPrevious[i].lines = metricsData.value(QString("%1-%2-Lines").arg(projectNames[currentRow], langName), dataCurrent[i].lines).toInt();
-                dataPrevious[i].linesOfCode = metricsData.value(QString("%1-%2-LinesOfCode").arg(projectNames[currentRow], langName), dataCurrent[i].linesOfCode).toInt();
-                dataPrevious[i].commentLines = metricsData.value(QString("%1-%2-CommentLines").arg(projectNames[currentRow], langName), dataCurrent[i].commentLines).toInt();
-                dataPrevious[i].commentWords = metricsData.value(QString("%1-%2-CommentWords").arg(projectNames[currentRow], langName), dataCurrent[i].commentWords).toInt();
-                dataPrevious[i].blankLines = metricsData.value(QString("%1-%2-BlankLines").arg(projectNames[currentRow], langName), dataCurrent[i].blankLines).toInt();
-
-                metricsData.setValue(QString("%1-%2-SourceFiles").arg(projectNames[currentRow], langName), dataCurrent[i].sourceFiles);
-                metricsData.setValue(QString("%1-%2-Lines").arg(projectNames[currentRow], langName), dataCurrent[i].lines);
-                metricsData.setValue(QString("%1-%2-LinesOfCode").arg(projectNames[currentRow], langName), dataCurrent[i].linesOfCode);
-                metricsData.setValue(QString("%1-%2-CommentLines").arg(projectNames[currentRow], langName), dataCurrent[i].commentLines);
-                metricsData.setValue(QString("%1-%2-CommentWords").arg(projectNames[currentRow], langName), dataCurrent[i].commentWords);
-                metricsData.setValue(QString("%1-%2-BlankLines").arg(projectNames[currentRow], langName), dataCurrent[i].blankLines);
-            }
+            memcpy(dataPrevious, previous ? previous->data : dataCurrent, sizeof(MetricsData) * Language::TypeCount);
+            metricsStore.append(projectNames[currentRow], dataCurrent);
 
             updateMetricsDifference();
         }
 
-        if (!filesList.isEmpty())
+        if (!ui->metricsTable->isRowHidden(Language::TypeCount))
             ui->progressBar->setFormat("Done.");
         else
             ui->progressBar->setFormat("No source files have been found!");
 
         canUpdateDiff = true;
+
+        if (watchAction->isChecked())
+            startWatching();
     }
 
     // Widgets are on
@@ -674,6 +716,123 @@ void MainWindow::count()
     counting = false;
 }
 
+/*
+===================
+MainWindow::finishBatch
+
+Saves the metrics of all projects at once and shows the selected one.
+===================
+*/
+void MainWindow::finishBatch()
+{
+    int currentRow = -1;
+
+    if (ui->projectsList->selectionModel()->isSelected(ui->projectsList->currentIndex()))
+        currentRow = ui->projectsList->currentIndex().row();
+
+    bool shown = (currentRow >= 0 && batchSnapshots.contains(projectNames[currentRow]));
+    clearMetricsTable();
+
+    if (shown)
+    {
+        const MetricsSnapshot *previous = metricsStore.latest(projectNames[currentRow]);
+        const MetricsSnapshot &snapshot = batchSnapshots[projectNames[currentRow]];
+
+        memcpy(dataCurrent, snapshot.data, sizeof(MetricsData) * Language::TypeCount);
+        memcpy(dataPrevious, previous ? previous->data : dataCurrent, sizeof(MetricsData) * Language::TypeCount);
+    }
+
+    int projectCount = batchSnapshots.size();
+    bool saved = metricsStore.append(batchSnapshots);
+    batchSnapshots.clear();
+
+    if (shown)
+    {
+        updateMetricsTable();
+        updateMetricsDifference();
+
+        countedPaths = projectPathList[currentRow];
+        countedIgnore = projectIgnoreList[currentRow];
+
+        if (watchAction->isChecked())
+            startWatching();
+    }
+
+    ui->progressBar->setValue(100);
+    ui->progressBar->setFormat(saved ? QString("Counted %1 projects.").arg(projectCount) : QString("Metrics couldn't be saved!"));
+    canUpdateDiff = shown;
+}
+
+/*
+===================
+MainWindow::setProfiling
+===================
+*/
+void MainWindow::setProfiling(bool enabled)
+{
+    // Recording may only start or stop between counts
+    if (counting)
+    {
+        profilingAction->blockSignals(true);
+        profilingAction->setChecked(!enabled);
+        profilingAction->blockSignals(false);
+        return;
+    }
+
+    Profiler::setEnabled(enabled);
+
+    if (!enabled)
+        profileDock->hide();
+}
+
+/*
+===================
+MainWindow::setWatching
+
+Only the metrics of a count that has finished can be kept current.
+===================
+*/
+void MainWindow::setWatching(bool enabled)
+{
+    if (enabled)
+    {
+        if (!counting && canUpdateDiff)
+            startWatching();
+
+        return;
+    }
+
+    if (watcher->isWatching())
+    {
+        watcher->stop();
+        fileCache.save(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/" + CACHE_FILENAME);
+    }
+}
+
+/*
+===================
+MainWindow::watchChanged
+===================
+*/
+void MainWindow::watchChanged()
+{
+    watcher->takeDifference(dataCurrent);
+    updateMetricsTable();
+
+    // Languages whose last file is gone aren't listed anymore
+    for (int i = 0; i < Language::TypeCount; i++)
+    {
+        if (!dataCurrent[i].sourceFiles && dataShown[i].sourceFiles >= 0)
+        {
+            ui->metricsTable->hideRow(metricsTableRows[i]);
+            dataShown[i] = MetricsData{-1, -1, -1, -1, -1, -1};
+        }
+    }
+
+    if (canUpdateDiff)
+        updateMetricsDifference();
+}
+
 /*
 ===================
 MainWindow::sort
@@ -706,6 +865,7 @@ void MainWindow::sort(int column)
 
             ui->metricsTable->removeRow(Language::TypeCount);
             ui->metricsTable->sortByColumn(column, ui->metricsTable->horizontalHeader()->sortIndicatorOrder());
+            updateMetricsTableRows();
             ui->metricsTable->insertRow(Language::TypeCount);
 
             for (int j = 0; j < NUMBER_OF_METRICS; j++)
@@ -754,7 +914,7 @@ MainWindow::closeEvent
 */
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    counting = false;
+    counter->stop();
     QMainWindow::closeEvent(event);
 }
 
@@ -773,34 +933,86 @@ void MainWindow::resizeEvent(QResizeEvent *event)
 
 /*
 ===================
-MainWindow::addPath
+MainWindow::clearMetricsTable
 ===================
 */
-void MainWindow::addPath(MetricsData &dataTotal, QList<SourceFile> &filesList, const QString &path, const QString &ext)
+void MainWindow::clearMetricsTable()
 {
-    for (int i = 0; i < Language::TypeCount; i++)
+    memset(&dataCurrent, 0, sizeof(MetricsData) * Language::TypeCount);
+
+    for (auto &data : dataShown)
+        data = MetricsData{-1, -1, -1, -1, -1, -1};
+
+    for (int i = 0; i < ui->metricsTable->rowCount(); i++)
     {
-        for (int j = 0; langList[i].ext[j]; j++)
+        ui->metricsTable->hideRow(i);
+
+        for (int j = 1; j < ui->metricsTable->columnCount(); j++)
         {
-            if (ext.compare(langList[i].ext[j], Qt::CaseInsensitive))
-                continue;
-
-            Language::Type langType = static_cast<Language::Type>(i);
-            int row = getMetricsTableIndex(langType);
-
-            filesList.append(SourceFile{path, langType});
-            dataCurrent[langType].sourceFiles++;
-            dataTotal.sourceFiles++;
-            ui->metricsTable->showRow(row);
-            ui->metricsTable->showRow(Language::TypeCount);
-            ui->metricsTable->item(row, 1)->setData(Qt::EditRole, dataCurrent[langType].sourceFiles);
-            ui->metricsTable->item(Language::TypeCount, 1)->setData(Qt::EditRole, dataTotal.sourceFiles);
-            QApplication::processEvents();
-            return;
+            ui->metricsTable->item(i, j)->setText(QString());
+
+            if (i != Language::TypeCount)
+                ui->metricsTable->item(i, j)->setBackground(QBrush(QColor("White")));
         }
     }
 }
 
+/*
+===================
+MainWindow::startWatching
+===================
+*/
+void MainWindow::startWatching()
+{
+    watcher->start(countedPaths, &fileCache, countedIgnore.patterns, countedIgnore.ignoreFiles);
+}
+
+/*
+===================
+MainWindow::updateMetricsTable
+
+Only cells whose values have changed since the last update are set,
+and the table is repainted once afterwards.
+===================
+*/
+void MainWindow::updateMetricsTable()
+{
+    MetricsData dataTotal;
+
+    ui->metricsTable->setUpdatesEnabled(false);
+
+    for (int i = 0; i < Language::TypeCount; i++)
+    {
+        if (!dataCurrent[i].sourceFiles)
+            continue;
+
+        updateMetricsRow(metricsTableRows[i], dataCurrent[i], dataShown[i]);
+        dataTotal += dataCurrent[i];
+    }
+
+    if (dataTotal.sourceFiles)
+        updateMetricsRow(Language::TypeCount, dataTotal, dataShown[Language::TypeCount]);
+
+    ui->metricsTable->setUpdatesEnabled(true);
+}
+
+/*
+===================
+MainWindow::updateMetricsRow
+===================
+*/
+void MainWindow::updateMetricsRow(int row, const MetricsData &data, MetricsData &shown)
+{
+    if (shown.sourceFiles < 0)
+        ui->metricsTable->showRow(row);
+
+    for (int j = 0; j < NUMBER_OF_METRICS - 1; j++)
+        if (data.*metricsColumns[j] != shown.*metricsColumns[j])
+            ui->metricsTable->item(row, j + 1)->setData(Qt::EditRole, data.*metricsColumns[j]);
+
+    shown = data;
+}
+
 /*
 ===================
 MainWindow::updateMetricsDifference
@@ -847,24 +1059,20 @@ void MainWindow::showDifference(QTableWidgetItem *item, int current, int previou
 
 /*
 ===================
-MainWindow::checkForKeyword
+MainWindow::updateMetricsTableRows
+
+Maps languages to their rows, which only move when the table is sorted.
 ===================
 */
-bool MainWindow::checkForKeyword(const QString &line, int index, const char *keyword) const
+void MainWindow::updateMetricsTableRows()
 {
-    int len = 0;
-
-    while (keyword[len] != '\0')
-        len++;
-
-    if (len <= 0 || index < 0 || index + len > line.length())
-        return false;
-
-    for (int i = 0; i < len; i++)
-        if (line[index + i] != keyword[i])
-            return false;
+    for (int i = 0; i < ui->metricsTable->rowCount(); i++)
+    {
+        QVariant type = ui->metricsTable->item(i, 0)->data(Qt::UserRole);
 
-    return true;
+        if (type.isValid())
+            metricsTableRows[type.toInt()] = i;
+    }
 }
 
 /*
@@ -874,9 +1082,5 @@ MainWindow::getMetricsTableIndex
 */
 int MainWindow::getMetricsTableIndex(Language::Type type) const
 {
-    for (int i = 0; i < ui->metricsTable->rowCount(); i++)
-        if (ui->metricsTable->item(i, 0)->data(Qt::UserRole).toInt() == type)
-            return i;
-
-    return -1;
+    return metricsTableRows[type];
 }
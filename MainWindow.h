@@ -22,10 +22,17 @@
 
 #include <QMainWindow>
 #include "FileSelectorModel.h"
+#include "Language.h"
+#include "FileCache.h"
+#include "MetricsStore.h"
 
 #define SETTINGS_FILENAME "Settings.ini"
 #define PROJECTS_FILENAME "Projects.ini"
-#define METRICS_FILENAME "Metrics.ini"
+#define METRICS_FILENAME "Metrics.dat"
+#define LEGACY_METRICS_FILENAME "Metrics.ini"
+#define CACHE_FILENAME "Cache.dat"
+#define IGNORE_FILENAME "Ignore.ini"
+#define TRACE_FILENAME "Trace.json"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -36,78 +43,13 @@ class QStringListModel;
 class QItemSelection;
 class ProjectsList;
 class DirsFirstProxyModel;
-
-enum cursorState
-{
-    None,
-    StringLiteral,
-    CharacterLiteral,
-    SingleLineComment,
-    MultiLineComment
-};
-
-struct Language
-{
-    enum Type
-    {
-        Assembly,
-        Basic,
-        C,
-        CSharp,
-        CPP,
-        CHeader,
-        Clojure,
-        CoffeeScript,
-        D,
-        FSharp,
-        GLSL,
-        Go,
-        Groovy,
-        Haskell,
-        HLSL,
-        Java,
-        JavaScript,
-        Kotlin,
-        Lisp,
-        Lua,
-        ObjectC,
-        PERL,
-        Pascal,
-        PHP,
-        Python,
-        R,
-        Ruby,
-        Rust,
-        Scala,
-        SQL,
-        Swift,
-        TypeScript,
-        TypeCount,
-        None
-    } type;
-
-    const char *name;
-    const char *singleComment[16];
-    const char *multipleCommentStart[16];
-    const char *multipleCommentEnd[16];
-    const char *ext[16];
-};
-
-struct SourceFile
-{
-    QString filename;
-    Language::Type langType;
-};
-
-struct MetricsData
-{
-    int sourceFiles = 0;
-    int lines = 0;
-    int linesOfCode = 0;
-    int commentLines = 0;
-    int commentWords = 0;
-    int blankLines = 0;
-};
+class Counter;
+class Watcher;
+class QTimer;
+class QPoint;
+class QDockWidget;
+class QPlainTextEdit;
+class QAction;
 
 /*
 ===========================================================
@@ -131,7 +73,14 @@ public Q_SLOTS:
     void removeProject();
     void projectClicked(const QItemSelection &selected, const QItemSelection &deselected);
     void projectNameChanged(const QModelIndex &index);
+    void showProjectMenu(const QPoint &pos);
     void count();
+    void countAll();
+    void countProgress();
+    void countFinished();
+    void setProfiling(bool enabled);
+    void setWatching(bool enabled);
+    void watchChanged();
     void sort(int column);
     void scrollToCenter();
 
@@ -142,11 +91,30 @@ protected:
 
 private:
 
-    void addPath(MetricsData &dataTotal, QList<SourceFile> &filesList, const QString &path, const QString &ext);
+    // What a project skips when it's counted
+    struct IgnoreSettings
+    {
+        QStringList patterns;
+        bool ignoreFiles = false;
+    };
+
+    // Projects with the same ignore settings and no nested paths, counted together
+    struct BatchRun
+    {
+        IgnoreSettings ignore;
+        QList<int> projects;
+    };
+
+    void startCounting();
+    void startBatchRun();
+    void finishBatch();
+    void clearMetricsTable();
+    void startWatching();
+    void updateMetricsTable();
+    void updateMetricsRow(int row, const MetricsData &data, MetricsData &shown);
+    void updateMetricsTableRows();
     void updateMetricsDifference() const;
     void showDifference(QTableWidgetItem *item, int current, int previous) const;
-    bool checkForKeyword(const QString &line, int index, const char *keyword) const;
-    Language::Type getLanguageType(const QString &ext) const;
     int getMetricsTableIndex(Language::Type index) const;
 
     bool counting = false;
@@ -156,10 +124,27 @@ private:
     QStringListModel *projectsListModel;
     FileSelectorModel *fileSelectorModel;
     DirsFirstProxyModel *proxyModel;
+    Counter *counter;
+    Watcher *watcher;
+    QTimer *progressTimer;
+    QAction *profilingAction;
+    QAction *watchAction;
+    QAction *countAllAction;
+    QDockWidget *profileDock;
+    QPlainTextEdit *profileText;
+    FileCache fileCache;
+    MetricsStore metricsStore;
     QStringList projectNames;
     QList<QStringList> projectPathList;
+    QList<IgnoreSettings> projectIgnoreList;
+    QStringList countedPaths;
+    IgnoreSettings countedIgnore;
+    QList<BatchRun> batchRuns;
+    QHash<QString, MetricsSnapshot> batchSnapshots;
     MetricsData dataCurrent[Language::TypeCount];
     MetricsData dataPrevious[Language::TypeCount];
+    MetricsData dataShown[Language::TypeCount + 1];
+    int metricsTableRows[Language::TypeCount];
 
     ProjectsList *projectsList;
 };
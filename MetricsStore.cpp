@@ -0,0 +1,433 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QDataStream>
+#include <QDateTime>
+#include <algorithm>
+
+#include "MetricsStore.h"
+
+#define METRICSSTORE_MAGIC 0x434D4D53 // CMMS
+#define METRICSSTORE_VERSION 1
+
+enum RecordType
+{
+    SnapshotRecord = 1,
+    RenameRecord,
+    RemoveRecord,
+    BatchRecord     // Records that are only saved together
+};
+
+/*
+===================
+getLanguageNames
+===================
+*/
+static QStringList getLanguageNames()
+{
+    QStringList names;
+
+    for (int i = 0; i < Language::TypeCount; i++)
+        names.append(langList[i].name);
+
+    return names;
+}
+
+/*
+===================
+snapshotRecord
+===================
+*/
+static QByteArray snapshotRecord(const QString &project, const MetricsSnapshot &snapshot)
+{
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(SnapshotRecord) << project << snapshot.time;
+
+    for (int i = 0; i < Language::TypeCount; i++)
+    {
+        const MetricsData &data = snapshot.data[i];
+        out << qint32(data.sourceFiles) << qint32(data.lines) << qint32(data.linesOfCode) << qint32(data.commentLines) << qint32(data.commentWords) << qint32(data.blankLines);
+    }
+
+    return record;
+}
+
+/*
+===================
+insertSnapshot
+
+Keeps snapshots in order of time, so snapshots of past revisions
+that are counted later don't become the latest ones.
+===================
+*/
+static void insertSnapshot(QList<MetricsSnapshot> &snapshots, const MetricsSnapshot &snapshot)
+{
+    auto it = std::upper_bound(snapshots.begin(), snapshots.end(), snapshot.time, [](qint64 time, const MetricsSnapshot &other){ return time < other.time; });
+    snapshots.insert(it, snapshot);
+}
+
+/*
+===================
+MetricsStore::load
+
+Snapshots are stored for the languages the file was written with, and
+are mapped to the current languages by name.
+===================
+*/
+bool MetricsStore::load(const QString &filename)
+{
+    this->filename = filename;
+    projects.clear();
+    valid = false;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic, version;
+    QStringList names;
+    in >> magic >> version >> names;
+
+    if (in.status() != QDataStream::Ok || magic != METRICSSTORE_MAGIC || version != METRICSSTORE_VERSION)
+        return false;
+
+    QList<int> types;
+    QStringList currentNames = getLanguageNames();
+
+    for (auto &name : names)
+        types.append(currentNames.indexOf(name));
+
+    bool compact = (names != currentNames);
+
+    while (!in.atEnd())
+    {
+        QByteArray record;
+        in >> record;
+
+        // A record that was cut off while being written is dropped along with anything after it
+        if (in.status() != QDataStream::Ok)
+        {
+            compact = true;
+            break;
+        }
+
+        readRecord(record, types);
+    }
+
+    valid = true;
+
+    if (compact)
+        rewrite();
+
+    return true;
+}
+
+/*
+===================
+MetricsStore::readRecord
+
+Applies a record to the snapshots in memory.
+===================
+*/
+void MetricsStore::readRecord(const QByteArray &record, const QList<int> &types)
+{
+    QDataStream recordIn(record);
+    recordIn.setVersion(QDataStream::Qt_6_0);
+
+    quint8 type;
+    QString project;
+    recordIn >> type >> project;
+
+    if (type == SnapshotRecord)
+    {
+        MetricsSnapshot snapshot;
+        recordIn >> snapshot.time;
+
+        for (int i = 0; i < types.size(); i++)
+        {
+            qint32 values[6];
+
+            for (auto &value : values)
+                recordIn >> value;
+
+            if (types[i] < 0)
+                continue;
+
+            MetricsData &data = snapshot.data[types[i]];
+            data.sourceFiles = values[0];
+            data.lines = values[1];
+            data.linesOfCode = values[2];
+            data.commentLines = values[3];
+            data.commentWords = values[4];
+            data.blankLines = values[5];
+        }
+
+        insertSnapshot(projects[project], snapshot);
+    }
+    else if (type == RenameRecord)
+    {
+        QString newName;
+        recordIn >> newName;
+        projects.insert(newName, projects.take(project));
+    }
+    else if (type == RemoveRecord)
+    {
+        projects.remove(project);
+    }
+    else if (type == BatchRecord)
+    {
+        QList<QByteArray> records;
+        recordIn >> records;
+
+        for (auto &batched : records)
+            readRecord(batched, types);
+    }
+}
+
+/*
+===================
+MetricsStore::migrate
+
+Imports metrics from the old per-key INI file, where every value was
+stored under "Project-Language-Metric" with slashes in language names
+replaced by spaces. The INI file itself is left untouched.
+===================
+*/
+bool MetricsStore::migrate(const QString &iniFilename)
+{
+    if (!QFile::exists(iniFilename))
+        return false;
+
+    static const struct
+    {
+        const char *name;
+        int MetricsData::*field;
+    } metricList[] = {
+        { "SourceFiles",    &MetricsData::sourceFiles },
+        { "Lines",          &MetricsData::lines },
+        { "LinesOfCode",    &MetricsData::linesOfCode },
+        { "CommentLines",   &MetricsData::commentLines },
+        { "CommentWords",   &MetricsData::commentWords },
+        { "BlankLines",     &MetricsData::blankLines }};
+
+    QStringList langNames;
+
+    for (int i = 0; i < Language::TypeCount; i++)
+        langNames.append(QString(langList[i].name).replace('/', ' '));
+
+    QSettings metricsData(iniFilename, QSettings::IniFormat);
+    QHash<QString, MetricsSnapshot> snapshots;
+    qint64 time = QFileInfo(iniFilename).lastModified().toMSecsSinceEpoch();
+
+    for (auto &key : metricsData.allKeys())
+    {
+        qsizetype separator = key.lastIndexOf('-');
+        if (separator < 0)
+            continue;
+
+        QString metric = key.mid(separator + 1);
+        QString rest = key.left(separator);
+
+        // Project names may contain dashes, so the longest language name that fits is taken
+        int langType = -1;
+
+        for (int i = 0; i < Language::TypeCount; i++)
+            if (rest.endsWith('-' + langNames[i]) && (langType < 0 || langNames[i].size() > langNames[langType].size()))
+                langType = i;
+
+        if (langType < 0)
+            continue;
+
+        QString project = rest.left(rest.size() - langNames[langType].size() - 1);
+
+        for (auto &entry : metricList)
+        {
+            if (metric == entry.name)
+            {
+                MetricsSnapshot &snapshot = snapshots[project];
+                snapshot.time = time;
+                snapshot.data[langType].*entry.field = metricsData.value(key).toInt();
+                break;
+            }
+        }
+    }
+
+    for (auto it = snapshots.cbegin(); it != snapshots.cend(); ++it)
+        projects[it.key()].append(it.value());
+
+    return rewrite();
+}
+
+/*
+===================
+MetricsStore::latest
+===================
+*/
+const MetricsSnapshot *MetricsStore::latest(const QString &project) const
+{
+    auto it = projects.constFind(project);
+    return it != projects.cend() && !it->isEmpty() ? &it->last() : nullptr;
+}
+
+/*
+===================
+MetricsStore::append
+===================
+*/
+bool MetricsStore::append(const QString &project, const MetricsData *data, qint64 time)
+{
+    MetricsSnapshot snapshot;
+    snapshot.time = (time ? time : QDateTime::currentMSecsSinceEpoch());
+    memcpy(snapshot.data, data, sizeof(MetricsData) * Language::TypeCount);
+
+    insertSnapshot(projects[project], snapshot);
+    return write(snapshotRecord(project, snapshot));
+}
+
+/*
+===================
+MetricsStore::append
+
+Appends snapshots of several projects as a single record, so either
+all of them are saved or none of them.
+===================
+*/
+bool MetricsStore::append(const QHash<QString, MetricsSnapshot> &snapshots)
+{
+    QList<QByteArray> records;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    for (auto it = snapshots.cbegin(); it != snapshots.cend(); ++it)
+    {
+        MetricsSnapshot snapshot = it.value();
+        snapshot.time = (snapshot.time ? snapshot.time : now);
+
+        insertSnapshot(projects[it.key()], snapshot);
+        records.append(snapshotRecord(it.key(), snapshot));
+    }
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(BatchRecord) << QString() << records;
+
+    return write(record);
+}
+
+/*
+===================
+MetricsStore::rename
+===================
+*/
+bool MetricsStore::rename(const QString &project, const QString &newName)
+{
+    if (!projects.contains(project) || project == newName)
+        return true;
+
+    projects.insert(newName, projects.take(project));
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(RenameRecord) << project << newName;
+
+    return write(record);
+}
+
+/*
+===================
+MetricsStore::remove
+===================
+*/
+bool MetricsStore::remove(const QString &project)
+{
+    if (!projects.remove(project))
+        return true;
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(RemoveRecord) << project;
+
+    return write(record);
+}
+
+/*
+===================
+MetricsStore::write
+
+Appends a record, unless there's no valid log to append to yet.
+===================
+*/
+bool MetricsStore::write(const QByteArray &record)
+{
+    if (!valid)
+        return rewrite();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << record;
+
+    return out.status() == QDataStream::Ok;
+}
+
+/*
+===================
+MetricsStore::rewrite
+
+Writes all snapshots into a new log, which replaces the old one only
+once it has been written completely.
+===================
+*/
+bool MetricsStore::rewrite()
+{
+    if (filename.isEmpty())
+        return false;
+
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint32(METRICSSTORE_MAGIC) << quint32(METRICSSTORE_VERSION) << getLanguageNames();
+
+    for (auto it = projects.cbegin(); it != projects.cend(); ++it)
+        for (auto &snapshot : it.value())
+            out << snapshotRecord(it.key(), snapshot);
+
+    if (out.status() != QDataStream::Ok || !file.commit())
+        return false;
+
+    valid = true;
+    return true;
+}
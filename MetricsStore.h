@@ -0,0 +1,77 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef METRICSSTORE_H
+#define METRICSSTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include "Language.h"
+
+struct MetricsSnapshot
+{
+    qint64 time = 0;
+    MetricsData data[Language::TypeCount];
+};
+
+/*
+===========================================================
+
+    MetricsStore
+
+    Snapshots of project metrics, kept in memory per project and
+    stored in a binary log. Saving a snapshot, renaming or removing
+    a project appends a single record instead of rewriting the
+    whole file. Snapshots of projects counted together share a
+    record, so they're saved all at once. The log is compacted
+    when it's loaded, if it was written for a different set of
+    languages.
+
+===========================================================
+*/
+class MetricsStore
+{
+public:
+
+    bool load(const QString &filename);
+    bool migrate(const QString &iniFilename);
+
+    bool contains(const QString &project) const { return projects.contains(project); }
+    const MetricsSnapshot *latest(const QString &project) const;
+    QList<MetricsSnapshot> history(const QString &project) const { return projects.value(project); }
+    QStringList projectNames() const { return projects.keys(); }
+
+    bool append(const QString &project, const MetricsData *data, qint64 time = 0);
+    bool append(const QHash<QString, MetricsSnapshot> &snapshots);
+    bool rename(const QString &project, const QString &newName);
+    bool remove(const QString &project);
+
+private:
+
+    void readRecord(const QByteArray &record, const QList<int> &types);
+    bool write(const QByteArray &record);
+    bool rewrite();
+
+    QString filename;
+    QHash<QString, QList<MetricsSnapshot>> projects;
+    bool valid = false;
+};
+
+#endif // METRICSSTORE_H
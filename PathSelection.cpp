@@ -0,0 +1,187 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include "PathSelection.h"
+
+/*
+===================
+PathSelection::setChecked
+
+Rules below the path are dropped, as the new state applies to the whole
+subtree. The cost depends on the depth of the path and the number of
+rules dropped, never on the number of files in the subtree.
+===================
+*/
+void PathSelection::setChecked(const QString &path, bool checked)
+{
+    QStringList parts = splitPath(path);
+    QList<Node *> chain;
+    Node *node = &root;
+    Rule inherited = NoRule;
+
+    for (auto &part : parts)
+    {
+        if (node->rule != NoRule)
+            inherited = node->rule;
+
+        chain.append(node);
+
+        std::unique_ptr<Node> &child = node->children[part];
+        if (!child)
+            child = std::make_unique<Node>();
+
+        node = child.get();
+    }
+
+    int includes = -node->includes - (node->rule == Include);
+    int excludes = -node->excludes - (node->rule == Exclude);
+
+    node->children.clear();
+    node->includes = 0;
+    node->excludes = 0;
+    node->rule = NoRule;
+
+    // A rule is only needed when it differs from what's inherited
+    if (checked != (inherited == Include))
+        node->rule = (checked ? Include : Exclude);
+
+    includes += (node->rule == Include);
+    excludes += (node->rule == Exclude);
+
+    for (auto *ancestor : chain)
+    {
+        ancestor->includes += includes;
+        ancestor->excludes += excludes;
+    }
+
+    // Removes nodes that no longer lead to any rule
+    for (int i = chain.size() - 1; i >= 0; i--)
+    {
+        Node *child = chain[i]->children[parts[i]].get();
+
+        if (child->rule != NoRule || !child->children.empty())
+            break;
+
+        chain[i]->children.erase(parts[i]);
+    }
+}
+
+/*
+===================
+PathSelection::checkState
+===================
+*/
+Qt::CheckState PathSelection::checkState(const QString &path) const
+{
+    const Node *node = &root;
+    Rule inherited = NoRule;
+
+    for (auto &part : splitPath(path))
+    {
+        if (node->rule != NoRule)
+            inherited = node->rule;
+
+        auto it = node->children.find(part);
+
+        // No rules below, the state is the inherited one
+        if (it == node->children.end())
+            return (inherited == Include ? Qt::Checked : Qt::Unchecked);
+
+        node = it->second.get();
+    }
+
+    if (node->rule != NoRule)
+        inherited = node->rule;
+
+    if (inherited == Include)
+        return (node->excludes ? Qt::PartiallyChecked : Qt::Checked);
+    else
+        return (node->includes ? Qt::PartiallyChecked : Qt::Unchecked);
+}
+
+/*
+===================
+PathSelection::getPathList
+
+Returns the smallest list of paths covering the selection. Only included
+directories with exclusions below are listed from the file system.
+===================
+*/
+void PathSelection::getPathList(QStringList &pathList, QDir::Filters filters) const
+{
+    getPathList(root, QString(), NoRule, pathList, filters);
+}
+
+/*
+===================
+PathSelection::getPathList
+===================
+*/
+void PathSelection::getPathList(const Node &node, const QString &path, Rule inherited, QStringList &pathList, QDir::Filters filters) const
+{
+    if (inherited == Include)
+    {
+        for (auto &name : QDir(path).entryList(filters))
+            if (!node.children.count(name))
+                pathList.append(joinPath(path, name));
+    }
+
+    for (auto &[name, child] : node.children)
+    {
+        Rule rule = (child->rule != NoRule ? child->rule : inherited);
+        QString childPath = joinPath(path, name);
+
+        if (rule == Include && !child->excludes)
+            pathList.append(childPath);
+        else if (rule == Include || child->includes)
+            getPathList(*child, childPath, rule, pathList, filters);
+    }
+}
+
+/*
+===================
+PathSelection::splitPath
+
+The root stays a component of its own: "/", "C:" or "//server".
+===================
+*/
+QStringList PathSelection::splitPath(const QString &path)
+{
+    QStringList parts = path.split('/', Qt::SkipEmptyParts);
+
+    if (path.startsWith("//") && !parts.isEmpty())
+        parts[0].prepend("//");
+    else if (path.startsWith('/'))
+        parts.prepend("/");
+
+    return parts;
+}
+
+/*
+===================
+PathSelection::joinPath
+===================
+*/
+QString PathSelection::joinPath(const QString &path, const QString &name)
+{
+    if (path.isEmpty())
+        return name;
+
+    return path.endsWith('/') ? path + name : path + '/' + name;
+}
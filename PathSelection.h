@@ -0,0 +1,74 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef PATHSELECTION_H
+#define PATHSELECTION_H
+
+#include <QDir>
+#include <QStringList>
+#include <map>
+#include <memory>
+
+/*
+===========================================================
+
+    PathSelection
+
+    Checked files and directories as a trie of path components,
+    where a node may include or exclude its whole subtree. Only
+    rules that change the state inherited from above are kept,
+    and every node counts the rules below it, so checking and
+    looking up a path only walk down its own components.
+
+===========================================================
+*/
+class PathSelection
+{
+public:
+
+    void clear() { root = Node(); }
+    void setChecked(const QString &path, bool checked);
+    Qt::CheckState checkState(const QString &path) const;
+    void getPathList(QStringList &pathList, QDir::Filters filters) const;
+
+private:
+
+    enum Rule
+    {
+        NoRule,
+        Include,
+        Exclude
+    };
+
+    struct Node
+    {
+        std::map<QString, std::unique_ptr<Node>> children;
+        Rule rule = NoRule;
+        int includes = 0;   // Include rules below
+        int excludes = 0;   // Exclude rules below
+    };
+
+    static QStringList splitPath(const QString &path);
+    static QString joinPath(const QString &path, const QString &name);
+    void getPathList(const Node &node, const QString &path, Rule inherited, QStringList &pathList, QDir::Filters filters) const;
+
+    Node root;
+};
+
+#endif // PATHSELECTION_H
@@ -0,0 +1,258 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QTextStream>
+#include <memory>
+#include <vector>
+
+#include "Profiler.h"
+
+// Events beyond this are only added to the totals, so long counts don't run out of memory
+#define MAX_EVENTS_PER_THREAD (1 << 18)
+
+struct ProfileEvent
+{
+    const char *name;
+    qint64 start;
+    qint64 duration;
+};
+
+struct StageTotals
+{
+    qint64 calls = 0;
+    qint64 duration = 0;
+    int threads = 0;
+};
+
+struct ThreadLog
+{
+    int id = 0;
+    QList<ProfileEvent> events;
+    QHash<const char *, StageTotals> stages;
+    qint64 statistics[Profiler::StatisticCount] = {};
+};
+
+std::atomic<bool> Profiler::enabled = false;
+
+static QMutex logsMutex;
+static std::vector<std::unique_ptr<ThreadLog>> logs;
+static std::atomic<int> generation = 0;
+static std::atomic<qint64> lastEnd = 0;
+
+/*
+===================
+getClock
+===================
+*/
+static QElapsedTimer &getClock()
+{
+    static QElapsedTimer clock = []()
+    {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+
+    return clock;
+}
+
+/*
+===================
+getThreadLog
+
+Every thread writes to its own log, which it registers the first time
+it records something after a reset, so recording never takes a lock.
+===================
+*/
+static ThreadLog *getThreadLog()
+{
+    thread_local ThreadLog *log = nullptr;
+    thread_local int logGeneration = -1;
+
+    if (logGeneration != generation)
+    {
+        QMutexLocker locker(&logsMutex);
+        logs.push_back(std::make_unique<ThreadLog>());
+        log = logs.back().get();
+        log->id = static_cast<int>(logs.size());
+        logGeneration = generation;
+    }
+
+    return log;
+}
+
+/*
+===================
+Profiler::reset
+
+Drops everything recorded so far. Nothing may be recording meanwhile.
+===================
+*/
+void Profiler::reset()
+{
+    QMutexLocker locker(&logsMutex);
+    logs.clear();
+    generation++;
+    lastEnd = 0;
+    getClock().restart();
+}
+
+/*
+===================
+Profiler::now
+
+Nanoseconds since the last reset.
+===================
+*/
+qint64 Profiler::now()
+{
+    return getClock().nsecsElapsed();
+}
+
+/*
+===================
+Profiler::record
+===================
+*/
+void Profiler::record(const char *name, qint64 start, qint64 end)
+{
+    ThreadLog *log = getThreadLog();
+    StageTotals &totals = log->stages[name];
+
+    totals.calls++;
+    totals.duration += end - start;
+
+    if (log->events.size() < MAX_EVENTS_PER_THREAD)
+        log->events.append(ProfileEvent{name, start, end - start});
+
+    qint64 last = lastEnd;
+    while (last < end && !lastEnd.compare_exchange_weak(last, end));
+}
+
+/*
+===================
+Profiler::addValue
+===================
+*/
+void Profiler::addValue(Statistic statistic, qint64 value)
+{
+    getThreadLog()->statistics[statistic] += value;
+}
+
+/*
+===================
+Profiler::summary
+
+Time spent in every stage, added up over all threads, and the
+throughput over the time from the reset to the last recorded event.
+===================
+*/
+QString Profiler::summary()
+{
+    QMutexLocker locker(&logsMutex);
+    QMap<QString, StageTotals> stages;
+    qint64 statistics[StatisticCount] = {};
+
+    for (auto &log : logs)
+    {
+        for (auto it = log->stages.cbegin(); it != log->stages.cend(); ++it)
+        {
+            StageTotals &totals = stages[QString::fromLatin1(it.key())];
+            totals.calls += it->calls;
+            totals.duration += it->duration;
+            totals.threads++;
+        }
+
+        for (int i = 0; i < StatisticCount; i++)
+            statistics[i] += log->statistics[i];
+    }
+
+    double seconds = qMax<qint64>(lastEnd, 1) / 1e9;
+    QString text;
+    QTextStream out(&text);
+
+    out << QString("%1%2%3%4%5\n").arg("Stage", -16).arg("Threads", 10).arg("Calls", 12).arg("Total ms", 14).arg("Average us", 14);
+
+    for (auto it = stages.cbegin(); it != stages.cend(); ++it)
+    {
+        out << QString("%1%2%3%4%5\n").arg(it.key(), -16).arg(it->threads, 10).arg(it->calls, 12)
+                                      .arg(it->duration / 1e6, 14, 'f', 1).arg(it->duration / 1e3 / qMax<qint64>(it->calls, 1), 14, 'f', 1);
+    }
+
+    out << QString("\nWall time: %1 ms\n").arg(seconds * 1e3, 0, 'f', 1);
+    out << QString("Files: %1 (%2/s)\n").arg(statistics[Files]).arg(statistics[Files] / seconds, 0, 'f', 0);
+    out << QString("Bytes: %1 (%2 MB/s)\n").arg(statistics[Bytes]).arg(statistics[Bytes] / seconds / (1 << 20), 0, 'f', 1);
+    out << QString("Lines: %1 (%2/s)\n").arg(statistics[Lines]).arg(statistics[Lines] / seconds, 0, 'f', 0);
+
+    return text;
+}
+
+/*
+===================
+Profiler::writeTrace
+
+Writes complete events, one per scope, with times in microseconds as
+chrome://tracing and Perfetto expect, and the statistics as counters.
+===================
+*/
+bool Profiler::writeTrace(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QMutexLocker locker(&logsMutex);
+    QTextStream out(&file);
+    qint64 statistics[StatisticCount] = {};
+    const char *statisticNames[StatisticCount] = {"Files", "Bytes", "Lines"};
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CodeMetrics\"}}";
+
+    for (auto &log : logs)
+    {
+        out << QString(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1,\"args\":{\"name\":\"Thread %1\"}}").arg(log->id);
+
+        for (auto &event : log->events)
+        {
+            out << QString(",\n{\"name\":\"%1\",\"ph\":\"X\",\"pid\":1,\"tid\":%2,\"ts\":%3,\"dur\":%4}").arg(QString::fromLatin1(event.name)).arg(log->id)
+                                                                                                   .arg(event.start / 1e3, 0, 'f', 3).arg(event.duration / 1e3, 0, 'f', 3);
+        }
+
+        for (int i = 0; i < StatisticCount; i++)
+            statistics[i] += log->statistics[i];
+    }
+
+    for (int i = 0; i < StatisticCount; i++)
+    {
+        out << QString(",\n{\"name\":\"%1\",\"ph\":\"C\",\"pid\":1,\"ts\":%2,\"args\":{\"%1\":%3}}").arg(statisticNames[i])
+                                                                                          .arg(lastEnd / 1e3, 0, 'f', 3).arg(statistics[i]);
+    }
+
+    out << "\n]}\n";
+    out.flush();
+
+    return out.status() == QTextStream::Ok && file.error() == QFileDevice::NoError;
+}
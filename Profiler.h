@@ -0,0 +1,106 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <atomic>
+
+/*
+===========================================================
+
+    Profiler
+
+    Times the stages of counting on every thread and adds up
+    files, bytes and lines, for a summary and a trace in the
+    Chrome trace event format. While it's disabled, a scope
+    only checks a flag. Defining CODEMETRICS_NO_PROFILER
+    compiles the scopes out altogether.
+
+===========================================================
+*/
+class Profiler
+{
+public:
+
+    enum Statistic
+    {
+        Files,
+        Bytes,
+        Lines,
+        StatisticCount
+    };
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enable) { enabled = enable; }
+    static void reset();
+
+    static void add(Statistic statistic, qint64 value) { if (isEnabled()) addValue(statistic, value); }
+
+    static QString summary();
+    static bool writeTrace(const QString &filename);
+
+private:
+
+    friend class ProfileScope;
+
+    static qint64 now();
+    static void record(const char *name, qint64 start, qint64 end);
+    static void addValue(Statistic statistic, qint64 value);
+
+    static std::atomic<bool> enabled;
+};
+
+/*
+===========================================================
+
+    ProfileScope
+
+    Records the time from its construction to its destruction
+    as an event of the current thread.
+
+===========================================================
+*/
+class ProfileScope
+{
+public:
+
+    explicit ProfileScope(const char *name) : name(name), start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+    ~ProfileScope() { if (start >= 0) Profiler::record(name, start, Profiler::now()); }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+
+    const char *name;
+    qint64 start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef CODEMETRICS_NO_PROFILER
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
+
+#endif // PROFILER_H
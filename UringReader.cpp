@@ -0,0 +1,369 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QtGlobal>
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#define URING_SUPPORTED
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "Profiler.h"
+#include "UringReader.h"
+
+// Every file is an open, a read and a close
+#define URING_OPS_PER_FILE 3
+#define URING_OP_OPEN 0
+#define URING_OP_READ 1
+#define URING_OP_CLOSE 2
+
+/*
+===================
+UringReader::isSupported
+
+Whether the kernel can read files through a ring at all, tried once.
+===================
+*/
+bool UringReader::isSupported()
+{
+    static const bool supported = UringReader(1, 4096).isValid();
+    return supported;
+}
+
+#ifdef URING_SUPPORTED
+
+/*
+===================
+UringReader::UringReader
+===================
+*/
+UringReader::UringReader(int queueDepth, int bufferSize) : queueDepth(queueDepth), bufferSize(bufferSize)
+{
+    if (queueDepth > 0 && bufferSize > 0 && !setup())
+        release();
+}
+
+/*
+===================
+UringReader::~UringReader
+===================
+*/
+UringReader::~UringReader()
+{
+    release();
+}
+
+/*
+===================
+UringReader::setup
+
+Creates the ring and registers the file slots and the buffers.
+Direct descriptors need Linux 5.15, which the opcode probe can't
+tell, so a test file is opened and closed through the ring first.
+===================
+*/
+bool UringReader::setup()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ringFd = syscall(__NR_io_uring_setup, queueDepth * URING_OPS_PER_FILE, &params);
+    if (ringFd < 0)
+        return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sqRingSize = cqRingSize = qMax(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        sqRing = nullptr;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+
+    sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        sqes = nullptr;
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    // Opcodes
+    size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    io_uring_probe *probe = static_cast<io_uring_probe *>(calloc(1, probeSize));
+    bool supported = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) >= 0;
+
+    for (int op : { IORING_OP_OPENAT, IORING_OP_READ_FIXED, IORING_OP_CLOSE })
+        supported = supported && op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+
+    free(probe);
+
+    if (!supported)
+        return false;
+
+    // File slots, all empty
+    QList<int> files(queueDepth, -1);
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_FILES, files.data(), queueDepth) < 0)
+        return false;
+
+    // Buffers, one per slot
+    void *memory = mmap(nullptr, size_t(queueDepth) * bufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return false;
+
+    buffers = static_cast<char *>(memory);
+
+    iovec buffer = { buffers, size_t(queueDepth) * bufferSize };
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, &buffer, 1) < 0)
+        return false;
+
+    slots.resize(queueDepth);
+    for (int i = queueDepth - 1; i >= 0; i--)
+        freeSlots.append(i);
+
+    // Direct descriptors
+    bool opened = false;
+    add(".", 0);
+
+    while (inFlight())
+    {
+        if (!submitAndWait([&opened, this](quint64, const char *, qint64, bool) { opened = lastOpenResult >= 0; }))
+            return false;
+    }
+
+    return opened;
+}
+
+/*
+===================
+UringReader::release
+===================
+*/
+void UringReader::release()
+{
+    // Closing the ring cancels anything still in flight
+    if (ringFd >= 0)
+        close(ringFd);
+
+    if (buffers)
+        munmap(buffers, size_t(queueDepth) * bufferSize);
+
+    if (sqes)
+        munmap(sqes, sqesSize);
+
+    if (cqRing && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+
+    if (sqRing)
+        munmap(sqRing, sqRingSize);
+
+    ringFd = -1;
+    buffers = nullptr;
+    sqes = cqRing = sqRing = nullptr;
+    slots.clear();
+    freeSlots.clear();
+}
+
+/*
+===================
+UringReader::getSqe
+===================
+*/
+void *UringReader::getSqe()
+{
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes) + index;
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pendingSqes++;
+
+    return sqe;
+}
+
+/*
+===================
+UringReader::add
+
+Queues a file to be opened into a free slot, read whole into the
+slot's buffer and closed again. The read and close are hard linked,
+so the slot is emptied even when the read comes up short.
+===================
+*/
+void UringReader::add(const QByteArray &filename, quint64 tag)
+{
+    int index = freeSlots.takeLast();
+
+    Slot &slot = slots[index];
+    slot.filename = filename;
+    slot.tag = tag;
+    slot.completions = 0;
+    slot.openResult = slot.readResult = 0;
+
+    io_uring_sqe *openSqe = static_cast<io_uring_sqe *>(getSqe());
+    openSqe->opcode = IORING_OP_OPENAT;
+    openSqe->flags = IOSQE_IO_LINK;
+    openSqe->fd = AT_FDCWD;
+    openSqe->addr = reinterpret_cast<quint64>(slot.filename.constData());
+    openSqe->open_flags = O_RDONLY;
+    openSqe->file_index = index + 1;
+    openSqe->user_data = quint64(index) << 2 | URING_OP_OPEN;
+
+    io_uring_sqe *readSqe = static_cast<io_uring_sqe *>(getSqe());
+    readSqe->opcode = IORING_OP_READ_FIXED;
+    readSqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    readSqe->fd = index;
+    readSqe->addr = reinterpret_cast<quint64>(buffers + size_t(index) * bufferSize);
+    readSqe->len = bufferSize;
+    readSqe->buf_index = 0;
+    readSqe->user_data = quint64(index) << 2 | URING_OP_READ;
+
+    io_uring_sqe *closeSqe = static_cast<io_uring_sqe *>(getSqe());
+    closeSqe->opcode = IORING_OP_CLOSE;
+    closeSqe->file_index = index + 1;
+    closeSqe->user_data = quint64(index) << 2 | URING_OP_CLOSE;
+}
+
+/*
+===================
+UringReader::submitAndWait
+
+Submits everything queued by add(), waits for at least one file and
+hands every finished file to the callback. The data stays valid only
+until the callback returns. A file that filled its whole buffer may
+have been cut short, so it's reported as failed. If the ring itself
+breaks, every file in flight is reported as failed and the reader
+becomes invalid.
+===================
+*/
+bool UringReader::submitAndWait(const Callback &done)
+{
+    if (ringFd < 0)
+        return false;
+
+    int result;
+    do
+    {
+        PROFILE_SCOPE("Read");
+        result = syscall(__NR_io_uring_enter, ringFd, pendingSqes, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    } while (result < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+
+    if (result < 0)
+    {
+        QList<quint64> tags;
+        for (int i = 0; i < slots.size(); i++)
+            if (!freeSlots.contains(i))
+                tags.append(slots[i].tag);
+
+        release();
+
+        for (quint64 tag : std::as_const(tags))
+            done(tag, nullptr, 0, false);
+
+        return false;
+    }
+
+    pendingSqes -= result;
+
+    QList<int> finished;
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++)
+    {
+        const io_uring_cqe *cqe = static_cast<const io_uring_cqe *>(cqes) + (head & *cqMask);
+        Slot &slot = slots[cqe->user_data >> 2];
+
+        switch (cqe->user_data & 3)
+        {
+            case URING_OP_OPEN: slot.openResult = cqe->res; break;
+            case URING_OP_READ: slot.readResult = cqe->res; break;
+        }
+
+        if (++slot.completions == URING_OPS_PER_FILE)
+            finished.append(cqe->user_data >> 2);
+    }
+
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+    for (int index : std::as_const(finished))
+    {
+        Slot &slot = slots[index];
+        bool ok = slot.openResult >= 0 && slot.readResult >= 0 && slot.readResult < bufferSize;
+
+        lastOpenResult = slot.openResult;
+        done(slot.tag, buffers + size_t(index) * bufferSize, ok ? slot.readResult : 0, ok);
+        freeSlots.append(index);
+    }
+
+    return true;
+}
+
+#else
+
+UringReader::UringReader(int queueDepth, int bufferSize) : queueDepth(queueDepth), bufferSize(bufferSize) {}
+UringReader::~UringReader() {}
+bool UringReader::setup() { return false; }
+void UringReader::release() {}
+void *UringReader::getSqe() { return nullptr; }
+void UringReader::add(const QByteArray &, quint64) {}
+bool UringReader::submitAndWait(const Callback &) { return false; }
+
+#endif
@@ -0,0 +1,103 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef URINGREADER_H
+#define URINGREADER_H
+
+#include <QByteArray>
+#include <QList>
+#include <functional>
+
+/*
+===========================================================
+
+    UringReader
+
+    Reads small files whole through io_uring on Linux. Opening,
+    reading and closing a file are queued as one linked chain,
+    into a registered file slot and a registered buffer, so a
+    whole batch of files costs a single system call. Where the
+    kernel doesn't support it, isValid() returns false and files
+    have to be read the usual way.
+
+===========================================================
+*/
+class UringReader
+{
+public:
+
+    typedef std::function<void(quint64 tag, const char *data, qint64 size, bool ok)> Callback;
+
+    UringReader(int queueDepth, int bufferSize);
+    ~UringReader();
+
+    static bool isSupported();
+
+    bool isValid() const { return ringFd >= 0; }
+    int getBufferSize() const { return bufferSize; }
+
+    bool hasFreeSlot() const { return !freeSlots.isEmpty(); }
+    int inFlight() const { return slots.size() - freeSlots.size(); }
+
+    void add(const QByteArray &filename, quint64 tag);
+    bool submitAndWait(const Callback &done);
+
+private:
+
+    struct Slot
+    {
+        QByteArray filename;
+        quint64 tag = 0;
+        int completions = 0;
+        int openResult = 0;
+        int readResult = 0;
+    };
+
+    bool setup();
+    void release();
+    void *getSqe();
+
+    int queueDepth;
+    int bufferSize;
+    int ringFd = -1;
+    int pendingSqes = 0;
+    int lastOpenResult = 0;
+
+    QList<Slot> slots;
+    QList<int> freeSlots;
+    char *buffers = nullptr;
+
+    // Shared with the kernel
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    void *sqes = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    void *cqes = nullptr;
+};
+
+#endif // URINGREADER_H
@@ -0,0 +1,804 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Watcher.h"
+#include "FileCache.h"
+#include "IgnoreRules.h"
+#include "LineClassifier.h"
+
+// Changes are handled once nothing else has changed for this long, in milliseconds
+#define WATCH_DELAY 300
+
+#ifdef Q_OS_LINUX
+#define INOTIFY_MASK        (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW)
+#define INOTIFY_BUFFER_SIZE (64 << 10)
+#endif
+
+/*
+===================
+Watcher::Watcher
+===================
+*/
+Watcher::Watcher(QObject *parent) : QObject(parent), walker(stopped)
+{
+    delayTimer = new QTimer(this);
+    delayTimer->setSingleShot(true);
+    delayTimer->setInterval(WATCH_DELAY);
+
+    connect(delayTimer, SIGNAL(timeout()), SLOT(startBatch()));
+
+    // Directories are watched before they're listed, so nothing created in between is missed
+    walker.setDirectorySink([this](const QString &path, const std::shared_ptr<const IgnoreRules> &rules){ return watchDirectory(path, rules); });
+}
+
+/*
+===================
+Watcher::~Watcher
+===================
+*/
+Watcher::~Watcher()
+{
+    stop();
+}
+
+/*
+===================
+Watcher::start
+
+Watches the paths of a count that has just finished, with the same
+ignore settings. The cache has to hold every file that was counted,
+and it's only used by the watcher until it's stopped. The first batch
+walks all paths again, which sets up the watches and catches up with
+files changed since they were counted.
+===================
+*/
+void Watcher::start(const QStringList &pathList, FileCache *fileCache, const QStringList &patternList, bool useIgnoreFiles)
+{
+    stop();
+
+    stopped = false;
+    cache = fileCache;
+    roots.clear();
+
+    for (auto &path : pathList)
+        roots.append(QDir::cleanPath(path));
+
+    walker.setIgnorePatterns(patternList);
+    walker.setIgnoreFiles(useIgnoreFiles);
+
+#ifdef Q_OS_LINUX
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (inotifyFd < 0)
+        return;
+
+    notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &Watcher::readEvents);
+#else
+    systemWatcher = new QFileSystemWatcher(this);
+    connect(systemWatcher, SIGNAL(directoryChanged(QString)), SLOT(directoryChanged(QString)));
+#endif
+
+    watching = true;
+    pendingBaseline = true;
+    startBatch();
+}
+
+/*
+===================
+Watcher::stop
+
+Changes that haven't been taken yet are dropped.
+===================
+*/
+void Watcher::stop()
+{
+    stopped = true;
+    delayTimer->stop();
+
+    if (batchThread)
+    {
+        batchThread->wait();
+        delete batchThread;
+        batchThread = nullptr;
+    }
+
+#ifdef Q_OS_LINUX
+    delete notifier;
+    notifier = nullptr;
+
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+
+    delete systemWatcher;
+    systemWatcher = nullptr;
+
+    directories.clear();
+    subdirectories.clear();
+    descriptors.clear();
+    addedDirectories.clear();
+    removedDirectories.clear();
+    pendingFiles.clear();
+    pendingDirectories.clear();
+    pendingBaseline = false;
+    pendingWalk = false;
+    batchFiles.clear();
+    batchDirectories.clear();
+
+    for (auto &data : difference)
+        data = MetricsData();
+
+    hasDifference = false;
+    watching = false;
+}
+
+/*
+===================
+Watcher::takeDifference
+
+Adds what has changed since the last call to the given metrics.
+===================
+*/
+void Watcher::takeDifference(MetricsData *data)
+{
+    QMutexLocker locker(&differenceMutex);
+
+    for (int i = 0; i < Language::TypeCount; i++)
+    {
+        data[i] += difference[i];
+        difference[i] = MetricsData();
+    }
+
+    hasDifference = false;
+}
+
+/*
+===================
+Watcher::readEvents
+
+Only directories are watched, a change to a file is reported by the
+directory it's in. Files are gathered by path and looked at again
+once the batch runs, so it doesn't matter what happened to them in
+between. Directories that appear or disappear are listed again or
+dropped as a whole.
+===================
+*/
+void Watcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(inotify_event) char buffer[INOTIFY_BUFFER_SIZE];
+
+    forever
+    {
+        ssize_t size = read(inotifyFd, buffer, sizeof(buffer));
+
+        if (size <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            // Events were dropped, everything has to be listed again
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                pendingWalk = true;
+                continue;
+            }
+
+            QString directory;
+
+            {
+                QMutexLocker locker(&directoriesMutex);
+                directory = descriptors.value(event->wd);
+
+                // The watch is gone along with its directory
+                if (event->mask & IN_IGNORED)
+                    descriptors.remove(event->wd);
+            }
+
+            if (directory.isEmpty())
+                continue;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                pendingDirectories.insert(directory);
+                continue;
+            }
+
+            if (!event->len)
+                continue;
+
+            QString name = QFile::decodeName(event->name);
+
+            if (name.startsWith('.'))
+                continue;
+
+            QString path = (directory.endsWith('/') ? directory : directory + '/') + name;
+
+            if (event->mask & IN_ISDIR)
+                pendingDirectories.insert(path);
+            else if (getFileLanguageType(name) != Language::None)
+                pendingFiles.insert(path);
+        }
+    }
+
+    if (pendingWalk || !pendingFiles.isEmpty() || !pendingDirectories.isEmpty())
+        delayTimer->start();
+#endif
+}
+
+/*
+===================
+Watcher::directoryChanged
+
+QFileSystemWatcher doesn't tell what has changed, so the whole
+directory is listed again.
+===================
+*/
+void Watcher::directoryChanged(const QString &path)
+{
+    pendingDirectories.insert(path);
+    delayTimer->start();
+}
+
+/*
+===================
+Watcher::startBatch
+
+Only one batch runs at a time, changes that come in meanwhile wait for the next one.
+===================
+*/
+void Watcher::startBatch()
+{
+    if (!watching || batchThread)
+        return;
+
+    if (!pendingBaseline && !pendingWalk && pendingFiles.isEmpty() && pendingDirectories.isEmpty())
+        return;
+
+    batchFiles.swap(pendingFiles);
+    batchDirectories.swap(pendingDirectories);
+    batchBaseline = pendingBaseline;
+    batchWalk = pendingWalk;
+    pendingBaseline = false;
+    pendingWalk = false;
+
+    batchThread = QThread::create([this](){ runBatch(); });
+    connect(batchThread, SIGNAL(finished()), SLOT(batchFinished()));
+    batchThread->start();
+}
+
+/*
+===================
+Watcher::batchFinished
+===================
+*/
+void Watcher::batchFinished()
+{
+    // A batch of an earlier start may finish after it has been stopped
+    if (sender() != batchThread)
+        return;
+
+    batchThread->wait();
+    delete batchThread;
+    batchThread = nullptr;
+    batchFiles.clear();
+    batchDirectories.clear();
+
+    // QFileSystemWatcher isn't thread-safe, so the fallback is only told about directories here
+    if (systemWatcher)
+    {
+        QStringList added, removed;
+
+        {
+            QMutexLocker locker(&directoriesMutex);
+            added.swap(addedDirectories);
+            removed.swap(removedDirectories);
+        }
+
+        if (!removed.isEmpty())
+            systemWatcher->removePaths(removed);
+
+        if (!added.isEmpty())
+            systemWatcher->addPaths(added);
+
+        // Whatever changed before they were watched is picked up by listing them again
+        if (!batchBaseline)
+        {
+            for (auto &path : added)
+                pendingDirectories.insert(path);
+        }
+    }
+
+    bool changedMetrics;
+
+    {
+        QMutexLocker locker(&differenceMutex);
+        changedMetrics = hasDifference;
+    }
+
+    if (changedMetrics)
+        emit changed();
+
+    if (pendingWalk || !pendingFiles.isEmpty() || !pendingDirectories.isEmpty())
+        delayTimer->start();
+}
+
+/*
+===================
+Watcher::runBatch
+
+Directories go first, then files, in no particular order within
+either. A file of a directory that's new or gone is settled along
+with it and found unchanged afterwards.
+===================
+*/
+void Watcher::runBatch()
+{
+    if (batchBaseline || batchWalk)
+        walkAll(batchBaseline);
+
+    for (auto &path : batchDirectories)
+    {
+        if (stopped)
+            return;
+
+        rescanDirectory(path);
+    }
+
+    for (auto &path : batchFiles)
+    {
+        if (stopped)
+            return;
+
+        updateFile(path);
+    }
+}
+
+/*
+===================
+Watcher::walkAll
+
+The baseline only brings the cache up to date with what the count
+saw, files missing from it were counted as copies of other files.
+A walk after events were dropped also drops what's gone.
+===================
+*/
+void Watcher::walkAll(bool baseline)
+{
+    QMutex mutex;
+    QList<SourceFile> files;
+
+    fullWalk = true;
+    walker.walk(roots, [&](const SourceFile &file){ QMutexLocker locker(&mutex); files.append(file); });
+    fullWalk = false;
+
+    QSet<QString> listed;
+
+    for (auto &file : files)
+    {
+        if (stopped)
+            return;
+
+        updateFile(file, baseline);
+        listed.insert(file.filename);
+    }
+
+    if (baseline)
+        return;
+
+    QStringList gone;
+
+    {
+        QMutexLocker locker(&directoriesMutex);
+
+        for (auto it = directories.cbegin(); it != directories.cend(); ++it)
+        {
+            if (!QFileInfo(it.key()).isDir())
+                gone.append(it.key());
+        }
+    }
+
+    for (auto &path : gone)
+        removeDirectory(path);
+
+    for (auto &root : roots)
+    {
+        for (auto &path : cache->filesInside(root, true))
+        {
+            WatchedDirectory directory;
+
+            if (!listed.contains(path) && !QFileInfo::exists(path))
+                removeFile(path, findDirectory(directoryOf(path), directory) && isCounted(path, directory));
+        }
+    }
+}
+
+/*
+===================
+Watcher::rescanDirectory
+
+Lists a directory and any new directories under it. A directory that
+isn't watched yet is counted only if its parent is and it isn't
+ignored. Inotify reports a directory by name only when it appears or
+disappears, so a directory that's still watched under that name has
+been replaced and is dropped first.
+===================
+*/
+void Watcher::rescanDirectory(const QString &path)
+{
+    QFileInfo fileInfo(path);
+
+    if (!fileInfo.isDir() || fileInfo.isSymLink())
+    {
+        removeDirectory(path);
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    removeDirectory(path);
+#endif
+
+    WatchedDirectory directory;
+
+    if (!findDirectory(path, directory))
+    {
+        WatchedDirectory parent;
+        QString name = fileInfo.fileName();
+
+        if (!findDirectory(directoryOf(path), parent) || name.startsWith('.'))
+            return;
+
+        if (parent.entryRules && parent.entryRules->isIgnored(path, name, true))
+            return;
+
+        directory.rules = parent.entryRules;
+
+        if (!watchDirectory(path, directory.rules))
+            return;
+    }
+
+    QMutex mutex;
+    QList<SourceFile> files;
+    walker.relist(path, directory.rules, [&](const SourceFile &file){ QMutexLocker locker(&mutex); files.append(file); });
+
+    QSet<QString> listed;
+
+    for (auto &file : files)
+    {
+        if (stopped)
+            return;
+
+        updateFile(file, false);
+        listed.insert(file.filename);
+    }
+
+    // Subdirectories and files that are gone
+    QStringList gone;
+
+    {
+        QMutexLocker locker(&directoriesMutex);
+
+        for (auto &subdirectory : subdirectories.value(path))
+        {
+            if (!QFileInfo(subdirectory).isDir())
+                gone.append(subdirectory);
+        }
+    }
+
+    for (auto &subdirectory : gone)
+        removeDirectory(subdirectory);
+
+    findDirectory(path, directory);
+
+    for (auto &file : cache->filesInside(path, false))
+    {
+        if (!listed.contains(file) && !QFileInfo::exists(file))
+            removeFile(file, isCounted(file, directory));
+    }
+}
+
+/*
+===================
+Watcher::removeDirectory
+
+Stops watching a directory and everything under it. Files that were
+counted are taken away and forgotten by the cache, if the directory
+comes back they're classified again.
+===================
+*/
+void Watcher::removeDirectory(const QString &path)
+{
+    QString prefix = (path.endsWith('/') ? path : path + '/');
+    QHash<QString, WatchedDirectory> removed;
+
+    {
+        QMutexLocker locker(&directoriesMutex);
+        QStringList pending(1, path);
+
+        // Roots under a path that isn't watched can't be found through their parents
+        for (auto &root : roots)
+            if (root.startsWith(prefix))
+                pending.append(root);
+
+        while (!pending.isEmpty())
+        {
+            QString current = pending.takeLast();
+            pending.append(subdirectories.take(current).values());
+
+            auto it = directories.find(current);
+
+            if (it == directories.end())
+                continue;
+
+#ifdef Q_OS_LINUX
+            if (it->descriptor >= 0)
+            {
+                inotify_rm_watch(inotifyFd, it->descriptor);
+                descriptors.remove(it->descriptor);
+            }
+#else
+            removedDirectories.append(it.key());
+#endif
+
+            removed.insert(it.key(), *it);
+            directories.erase(it);
+        }
+
+        auto parent = subdirectories.find(directoryOf(path));
+
+        if (parent != subdirectories.end())
+        {
+            parent->remove(path);
+
+            if (parent->isEmpty())
+                subdirectories.erase(parent);
+        }
+    }
+
+    if (removed.isEmpty())
+        return;
+
+    for (auto &file : cache->filesInside(path, true))
+    {
+        auto directory = removed.constFind(directoryOf(file));
+        bool counted = (directory != removed.cend() && isCounted(file, *directory));
+
+        if (counted || !QFileInfo::exists(file))
+            removeFile(file, counted);
+    }
+}
+
+/*
+===================
+Watcher::watchDirectory
+
+Called for every directory the walker is about to list, from its
+threads. Directories that are watched already are only listed again
+by a full walk.
+===================
+*/
+bool Watcher::watchDirectory(const QString &path, const std::shared_ptr<const IgnoreRules> &rules)
+{
+    {
+        QMutexLocker locker(&directoriesMutex);
+
+        if (directories.contains(path))
+            return fullWalk;
+    }
+
+    WatchedDirectory directory;
+    directory.rules = rules;
+    directory.entryRules = walker.getEntryRules(path, rules);
+
+#ifdef Q_OS_LINUX
+    directory.descriptor = inotify_add_watch(inotifyFd, QFile::encodeName(path).constData(), INOTIFY_MASK);
+#endif
+
+    QMutexLocker locker(&directoriesMutex);
+    directories.insert(path, directory);
+
+    if (directoryOf(path) != path)
+        subdirectories[directoryOf(path)].insert(path);
+
+    if (directory.descriptor >= 0)
+        descriptors.insert(directory.descriptor, path);
+
+#ifndef Q_OS_LINUX
+    addedDirectories.append(path);
+#endif
+
+    return true;
+}
+
+/*
+===================
+Watcher::findDirectory
+===================
+*/
+bool Watcher::findDirectory(const QString &path, WatchedDirectory &directory) const
+{
+    QMutexLocker locker(&directoriesMutex);
+    auto it = directories.constFind(path);
+
+    if (it == directories.cend())
+        return false;
+
+    directory = *it;
+    return true;
+}
+
+/*
+===================
+Watcher::updateFile
+
+A file that was reported by its directory. Only files the walker
+would have counted are looked at.
+===================
+*/
+void Watcher::updateFile(const QString &path)
+{
+    WatchedDirectory directory;
+
+    if (!findDirectory(directoryOf(path), directory) || !isCounted(path, directory))
+        return;
+
+    QFileInfo fileInfo(path);
+
+    if (!fileInfo.isFile() || fileInfo.isSymLink())
+    {
+        removeFile(path, true);
+        return;
+    }
+
+    updateFile(SourceFile{path, getFileLanguageType(fileInfo.fileName()), fileInfo.size(), fileInfo.lastModified().toMSecsSinceEpoch()}, false);
+}
+
+/*
+===================
+Watcher::updateFile
+
+Classifies a file again unless its size and modification time are
+the same as in the cache, and adds what changed unless it's the baseline.
+===================
+*/
+void Watcher::updateFile(const SourceFile &file, bool baseline)
+{
+    const FileCacheEntry *cached = cache->find(file.filename);
+
+    if (cached && cached->size == file.size && cached->lastModified == file.lastModified)
+        return;
+
+    FileCacheEntry entry;
+    entry.size = file.size;
+    entry.lastModified = file.lastModified;
+
+    if (cache->isHashing())
+    {
+        // Files that were only touched keep their metrics
+        if (!cache->countHashed(file.filename, file.langType, entry))
+            return;
+    }
+    else if (!LineClassifier(file.langType).countFile(file.filename, entry.data))
+    {
+        return;
+    }
+
+    if (!baseline)
+        addDifference(file.langType, &entry.data, cached ? &cached->data : nullptr);
+
+    cache->insert(file.filename, entry);
+}
+
+/*
+===================
+Watcher::removeFile
+===================
+*/
+void Watcher::removeFile(const QString &path, bool counted)
+{
+    const FileCacheEntry *cached = cache->find(path);
+
+    if (!cached)
+        return;
+
+    if (counted)
+        addDifference(getFileLanguageType(path.mid(path.lastIndexOf('/') + 1)), nullptr, &cached->data);
+
+    cache->remove(path);
+}
+
+/*
+===================
+Watcher::addDifference
+
+A file with only new metrics has been added, one with only old metrics removed.
+===================
+*/
+void Watcher::addDifference(Language::Type langType, const MetricsData *added, const MetricsData *removed)
+{
+    QMutexLocker locker(&differenceMutex);
+    MetricsData &data = difference[langType];
+
+    if (added)
+    {
+        data += *added;
+
+        if (!removed)
+            data.sourceFiles++;
+    }
+
+    if (removed)
+    {
+        data -= *removed;
+
+        if (!added)
+            data.sourceFiles--;
+    }
+
+    hasDifference = true;
+}
+
+/*
+===================
+Watcher::isCounted
+
+Whether the walker would count a file of a watched directory.
+===================
+*/
+bool Watcher::isCounted(const QString &path, const WatchedDirectory &directory)
+{
+    QString name = path.mid(path.lastIndexOf('/') + 1);
+
+    if (name.startsWith('.') || getFileLanguageType(name) == Language::None)
+        return false;
+
+    return !directory.entryRules || !directory.entryRules->isIgnored(path, name, false);
+}
+
+/*
+===================
+Watcher::directoryOf
+===================
+*/
+QString Watcher::directoryOf(const QString &path)
+{
+    int index = path.lastIndexOf('/');
+    return (index > 0 ? path.left(index) : path.left(index + 1));
+}
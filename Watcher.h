@@ -0,0 +1,139 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+#include "DirectoryWalker.h"
+
+class QFileSystemWatcher;
+class QSocketNotifier;
+class QThread;
+class QTimer;
+class FileCache;
+class IgnoreRules;
+
+/*
+===========================================================
+
+    Watcher
+
+    Keeps the metrics of a count current after it's done. The
+    directories that were counted are watched, with inotify on
+    Linux and QFileSystemWatcher elsewhere, and changes are
+    gathered for a short while and then handled together on a
+    separate thread. Only changed files are classified again,
+    and what they add or take away is kept until it's taken.
+
+===========================================================
+*/
+class Watcher : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit Watcher(QObject *parent = nullptr);
+    ~Watcher();
+
+    void start(const QStringList &pathList, FileCache *fileCache, const QStringList &patternList, bool useIgnoreFiles);
+    void stop();
+
+    bool isWatching() const { return watching; }
+    void takeDifference(MetricsData *data);
+
+Q_SIGNALS:
+
+    void changed();
+
+private Q_SLOTS:
+
+    void readEvents();
+    void directoryChanged(const QString &path);
+    void startBatch();
+    void batchFinished();
+
+private:
+
+    struct WatchedDirectory
+    {
+        std::shared_ptr<const IgnoreRules> rules;       // Rules the directory is listed with
+        std::shared_ptr<const IgnoreRules> entryRules;  // Rules its entries are matched with
+        int descriptor = -1;
+    };
+
+    void runBatch();
+    void walkAll(bool baseline);
+    void rescanDirectory(const QString &path);
+    void removeDirectory(const QString &path);
+    bool watchDirectory(const QString &path, const std::shared_ptr<const IgnoreRules> &rules);
+    bool findDirectory(const QString &path, WatchedDirectory &directory) const;
+    void updateFile(const QString &path);
+    void updateFile(const SourceFile &file, bool baseline);
+    void removeFile(const QString &path, bool counted);
+    void addDifference(Language::Type langType, const MetricsData *added, const MetricsData *removed);
+
+    static bool isCounted(const QString &path, const WatchedDirectory &directory);
+    static QString directoryOf(const QString &path);
+
+    std::atomic<bool> stopped = false;
+    bool watching = false;
+    bool fullWalk = false;      // Every directory is listed, not only new ones
+    DirectoryWalker walker;
+    QStringList roots;
+    FileCache *cache = nullptr;
+
+    mutable QMutex directoriesMutex;
+    QHash<QString, WatchedDirectory> directories;
+    QHash<QString, QSet<QString>> subdirectories;     // Watched ones, by the path of their parent
+    QHash<int, QString> descriptors;
+    QStringList addedDirectories;       // Still have to be watched by the fallback
+    QStringList removedDirectories;
+
+    int inotifyFd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QFileSystemWatcher *systemWatcher = nullptr;
+
+    // Changes gathered until the next batch
+    QTimer *delayTimer;
+    QSet<QString> pendingFiles;
+    QSet<QString> pendingDirectories;
+    bool pendingBaseline = false;
+    bool pendingWalk = false;
+
+    // Changes handled by the running batch
+    QThread *batchThread = nullptr;
+    QSet<QString> batchFiles;
+    QSet<QString> batchDirectories;
+    bool batchBaseline = false;
+    bool batchWalk = false;
+
+    QMutex differenceMutex;
+    MetricsData difference[Language::TypeCount];
+    bool hasDifference = false;
+};
+
+#endif // WATCHER_H
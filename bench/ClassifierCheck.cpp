@@ -0,0 +1,300 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QTemporaryFile>
+#include <QThread>
+#include <iterator>
+
+#include "ClassifierCheck.h"
+#include "FileCache.h"
+#include "LineClassifier.h"
+#include "ReferenceClassifier.h"
+
+// Reports only the first mismatches in detail
+#define MAX_REPORTED_FAILURES 20
+
+static const char *tokenList[] = {
+    "\"", "\'", "\\", "\\\\", "\\\"", "\n", "\n", "\r\n", "\r", " ", "  ", "\t", "\v",
+    "a", "word", "Z", "7", "_", ";", "=", "-", "*", "/", "#", "{", "}", "(", ")", "[", "]",
+    "\xC3\xA9", "\xE6\x97\xA5", "\xF0\x9F\x98\x80", "\xC2\xA0", "\xE3\x80\x80", "\xC3", "\xFF", "\xED\xA0\x80"};
+
+/*
+===================
+ClassifierCheck::compare
+
+Counts the text with both classifiers, from memory and from a file,
+and reports every metric that differs.
+===================
+*/
+bool ClassifierCheck::compare(Language::Type type, const QByteArray &text, const QString &origin)
+{
+    MetricsData expected, fromMemory, fromFile;
+    ReferenceClassifier(type).count(text, expected);
+    LineClassifier(type).count(text.constData(), text.size(), fromMemory);
+
+    QTemporaryFile file;
+    if (file.open())
+    {
+        file.write(text);
+        file.close();
+        LineClassifier(type).countFile(file.fileName(), fromFile);
+    }
+
+    return report(type, origin, expected, {{"memory", &fromMemory}, {"file", &fromFile}});
+}
+
+/*
+===================
+ClassifierCheck::report
+
+Reports every metric that differs from the expected one.
+===================
+*/
+bool ClassifierCheck::report(Language::Type type, const QString &origin, const MetricsData &expected, const QList<Result> &results)
+{
+    static const struct
+    {
+        const char *name;
+        int MetricsData::*field;
+    } metricList[] = {
+        { "lines",          &MetricsData::lines },
+        { "linesOfCode",    &MetricsData::linesOfCode },
+        { "commentLines",   &MetricsData::commentLines },
+        { "commentWords",   &MetricsData::commentWords },
+        { "blankLines",     &MetricsData::blankLines }};
+
+    checks++;
+    bool passed = true;
+
+    for (auto &metric : metricList)
+    {
+        for (auto &result : results)
+        {
+            if (result.data->*metric.field == expected.*metric.field)
+                continue;
+
+            if (passed && ++failures <= MAX_REPORTED_FAILURES)
+                out << langList[type].name << ", " << origin << ":\n";
+
+            if (failures <= MAX_REPORTED_FAILURES)
+            {
+                out << "    " << metric.name << " (" << result.name << ") "
+                    << result.data->*metric.field << ", expected " << expected.*metric.field << "\n";
+            }
+
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+/*
+===================
+ClassifierCheck::checkCorpus
+===================
+*/
+void ClassifierCheck::checkCorpus(const CorpusGenerator &generator, const QList<Language::Type> &types, int files)
+{
+    for (auto type : types)
+        for (int i = 0; i < files; i++)
+            compare(type, generator.generateFile(type, i), QString("generated file %1").arg(i));
+}
+
+/*
+===================
+ClassifierCheck::fuzz
+===================
+*/
+void ClassifierCheck::fuzz(const QList<Language::Type> &types, quint64 seed, int iterations)
+{
+    for (auto type : types)
+    {
+        for (int i = 0; i < iterations; i++)
+        {
+            CorpusGenerator::Random random(seed ^ (static_cast<quint64>(type) << 32) ^ static_cast<quint64>(i));
+            random.next();
+
+            compare(type, fuzzText(type, random), QString("seed %1, input %2").arg(seed).arg(i));
+        }
+    }
+}
+
+/*
+===================
+ClassifierCheck::checkLargeFile
+
+Writes a file bigger than PARALLEL_SIZE_LIMIT out of random inputs,
+with multi-line comments longer than two chunks, so they always span
+a chunk boundary. With a long line, the file also gets a comment
+across the end of the first mapping window and a line longer than a
+whole window after it, which makes it more than twice MAP_SIZE_LIMIT.
+Both classifiers count the file itself, it isn't kept in memory, and
+it's also counted the way the cache does when it hashes files.
+===================
+*/
+void ClassifierCheck::checkLargeFile(Language::Type type, quint64 seed, bool longLine)
+{
+    const Language &language = langList[type];
+    CorpusGenerator::Random random(seed ^ (static_cast<quint64>(type) << 32) ^ Q_UINT64_C(0xFFFFFFFF));
+    random.next();
+
+    QTemporaryFile file;
+    if (!file.open())
+    {
+        out << "Couldn't write a large file.\n";
+        failures++;
+        return;
+    }
+
+    bool written = true;
+
+    auto write = [&file, &written](const QByteArray &text)
+    {
+        if (written && file.write(text) != text.size())
+            written = false;
+    };
+
+    auto fill = [this, type, &random, &file, &written, &write](qint64 until)
+    {
+        while (written && file.pos() < until)
+            write(fuzzText(type, random).append('\n'));
+    };
+
+    // Languages without multi-line comments get a long run of single-line ones instead
+    auto comment = [&language, &file, &written, &write](qint64 length)
+    {
+        const char *start = language.multipleCommentStart[0];
+        const char *prefix = (!start && language.singleComment[0] ? language.singleComment[0] : "");
+        QByteArray lines = QByteArray(prefix).append(" words in a \"long\" comment\n").repeated(1024);
+        qint64 until = file.pos() + length;
+
+        if (start)
+            write(QByteArray(start).append(" comment\n"));
+
+        while (written && file.pos() < until)
+            write(lines);
+
+        if (start)
+            write(QByteArray(language.multipleCommentEnd[0]).append('\n'));
+    };
+
+    // Starts with a plain line, a UTF-16 byte order mark would keep the file from being mapped
+    write("begin\n");
+
+    fill(CHUNK_SIZE / 2);
+    comment(2 * CHUNK_SIZE + 1);
+    fill(PARALLEL_SIZE_LIMIT);
+    comment(2 * CHUNK_SIZE + 1);
+    fill(PARALLEL_SIZE_LIMIT + 4 * CHUNK_SIZE);
+
+    if (longLine)
+    {
+        fill(MAP_SIZE_LIMIT - CHUNK_SIZE);
+        comment(2 * CHUNK_SIZE + 1);
+
+        QByteArray code = QByteArray("word = 7; ").repeated(1024 * 1024);
+        qint64 until = file.pos() + MAP_SIZE_LIMIT + CHUNK_SIZE;
+
+        while (written && file.pos() < until)
+            write(code);
+
+        write("\n");
+        fill(file.pos() + 2 * CHUNK_SIZE);
+    }
+
+    file.close();
+
+    if (!written)
+    {
+        out << "Couldn't write a large file.\n";
+        failures++;
+        return;
+    }
+
+    if (QThread::idealThreadCount() < 2)
+        out << "Only one core, the large file isn't classified in parallel.\n";
+
+    MetricsData expected, fromFile;
+    ReferenceClassifier(type).countFile(file.fileName(), expected);
+    LineClassifier(type).countFile(file.fileName(), fromFile);
+
+    // Counts with cache hashing on take their own way through the file
+    FileCache cache;
+    FileCacheEntry hashed;
+    cache.setHashing(true);
+    hashed.size = file.size();
+    cache.countHashed(file.fileName(), type, hashed);
+
+    report(type, QString("large file of %1 MB, seed %2").arg(file.size() >> 20).arg(seed), expected, {{"file", &fromFile}, {"hashed", &hashed.data}});
+}
+
+/*
+===================
+ClassifierCheck::fuzzText
+
+Comment markers are picked as often as all the other tokens together,
+so the states of a line change often. Byte order marks only appear at
+the beginning, like in real files.
+===================
+*/
+QByteArray ClassifierCheck::fuzzText(Language::Type type, CorpusGenerator::Random &random) const
+{
+    const Language &language = langList[type];
+    QList<const char *> markers;
+
+    for (int k = 0; language.singleComment[k]; k++)
+        markers.append(language.singleComment[k]);
+
+    for (int k = 0; language.multipleCommentStart[k]; k++)
+        markers.append(language.multipleCommentStart[k]);
+
+    for (int k = 0; language.multipleCommentEnd[k]; k++)
+        markers.append(language.multipleCommentEnd[k]);
+
+    QByteArray text;
+
+    switch (random.bounded(32))
+    {
+    case 0: text.append("\xEF\xBB\xBF"); break;
+    case 1: text.append("\xFF\xFE"); break;
+    case 2: text.append("\xFE\xFF"); break;
+    default: break;
+    }
+
+    int tokens = random.bounded(random.chance(0.1) ? 2000 : 200);
+
+    for (int i = 0; i < tokens; i++)
+    {
+        if (!markers.isEmpty() && random.chance(0.5))
+        {
+            const char *marker = markers[random.bounded(markers.size())];
+            int length = static_cast<int>(qstrlen(marker));
+
+            // Also cuts markers short
+            text.append(marker, random.chance(0.9) ? length : random.bounded(length + 1));
+        }
+        else
+        {
+            text.append(tokenList[random.bounded(static_cast<int>(std::size(tokenList)))]);
+        }
+    }
+
+    return text;
+}
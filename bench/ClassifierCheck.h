@@ -0,0 +1,71 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef CLASSIFIERCHECK_H
+#define CLASSIFIERCHECK_H
+
+#include <QTextStream>
+#include "CorpusGenerator.h"
+
+/*
+===========================================================
+
+    ClassifierCheck
+
+    Compares LineClassifier with ReferenceClassifier metric by
+    metric, on generated files and on random inputs built from
+    the comment markers of a language, quotes, escapes, line
+    breaks, multibyte and invalid UTF-8. Inputs only depend on
+    the seed, so a mismatch can be reproduced. A large file
+    checks the parallel classification of files too big to be
+    classified in one go.
+
+===========================================================
+*/
+class ClassifierCheck
+{
+public:
+
+    explicit ClassifierCheck(QTextStream &out) : out(out) {}
+
+    bool compare(Language::Type type, const QByteArray &text, const QString &origin);
+    void checkCorpus(const CorpusGenerator &generator, const QList<Language::Type> &types, int files);
+    void fuzz(const QList<Language::Type> &types, quint64 seed, int iterations);
+    void checkLargeFile(Language::Type type, quint64 seed, bool longLine);
+
+    int getChecks() const { return checks; }
+    int getFailures() const { return failures; }
+
+private:
+
+    struct Result
+    {
+        const char *name;
+        const MetricsData *data;
+    };
+
+    bool report(Language::Type type, const QString &origin, const MetricsData &expected, const QList<Result> &results);
+    QByteArray fuzzText(Language::Type type, CorpusGenerator::Random &random) const;
+
+    QTextStream &out;
+    int checks = 0;
+    int failures = 0;
+};
+
+#endif // CLASSIFIERCHECK_H
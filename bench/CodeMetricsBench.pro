@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Throughput benchmark of the counting core on
+# generated source files, and a check of the
+# classifier against the reference classifier
+# and of counting nested projects together
+#
+#-------------------------------------------------
+
+QT       = core
+
+CONFIG += c++20 console release
+CONFIG -= app_bundle
+
+TARGET = codemetrics-bench
+TEMPLATE = app
+
+include(../Core.pri)
+
+SOURCES += \
+    ClassifierCheck.cpp \
+    CorpusGenerator.cpp \
+    GroupCheck.cpp \
+    Main.cpp \
+    ReferenceClassifier.cpp
+
+HEADERS += \
+    ClassifierCheck.h \
+    CorpusGenerator.h \
+    GroupCheck.h \
+    ReferenceClassifier.h
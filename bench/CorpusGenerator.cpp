@@ -0,0 +1,259 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QDir>
+#include <QFile>
+#include <iterator>
+
+#include "CorpusGenerator.h"
+
+static const char *wordList[] = {
+    "value", "index", "count", "buffer", "result", "node", "parent", "size", "offset", "name",
+    "data", "state", "first", "last", "item", "list", "table", "stream", "token", "length",
+    "x", "i", "tmp", "données", "größe", "значение", "描述"};
+
+static const char *operatorList[] = {" = ", " + ", " - ", " * ", " / ", " == ", " < ", ", ", "(", ")", "[", "]", "; ", ".", "->", " && "};
+
+/*
+===================
+CorpusGenerator::Random::next
+
+SplitMix64, so corpora don't depend on the standard library.
+===================
+*/
+quint64 CorpusGenerator::Random::next()
+{
+    quint64 z = (state += Q_UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+/*
+===================
+CorpusGenerator::generateFile
+===================
+*/
+QByteArray CorpusGenerator::generateFile(Language::Type type, int index) const
+{
+    const Language &language = langList[type];
+    Random random(options.seed ^ (static_cast<quint64>(type) << 32) ^ static_cast<quint64>(index));
+    random.next();
+
+    // File sizes vary between half and one and a half of the average
+    int size = options.fileSize / 2 + random.bounded(qMax(options.fileSize, 1));
+    QByteArray text;
+    text.reserve(size + options.lineLength * 4);
+
+    while (text.size() < size)
+    {
+        double kind = random.real();
+
+        if (kind < options.blankDensity)
+        {
+            // Blank lines, sometimes with whitespace
+            if (random.chance(0.3))
+                text.append(QByteArray(random.bounded(8) + 1, random.chance(0.5) ? ' ' : '\t'));
+        }
+        else if (kind < options.blankDensity + options.commentDensity)
+        {
+            appendComment(text, random, language);
+        }
+        else
+        {
+            QByteArray line(random.bounded(4) * 4, ' ');
+            appendCode(line, random, language, options.lineLength / 2 + random.bounded(qMax(options.lineLength, 1)));
+            text.append(line);
+        }
+
+        text.append(random.chance(0.05) ? "\r\n" : "\n");
+    }
+
+    return text;
+}
+
+/*
+===================
+CorpusGenerator::generate
+
+Writes files as <directory>/<language>/<index>.<extension>.
+===================
+*/
+bool CorpusGenerator::generate(const QString &directory, const QList<Language::Type> &types) const
+{
+    for (auto type : types)
+    {
+        QString langDirectory = QString("%1/%2").arg(directory, QString::number(type));
+
+        if (!QDir().mkpath(langDirectory))
+            return false;
+
+        for (int i = 0; i < options.filesPerLanguage; i++)
+        {
+            QFile file(QString("%1/%2.%3").arg(langDirectory).arg(i).arg(langList[type].ext[0]));
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                return false;
+
+            if (file.write(generateFile(type, i)) < 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+===================
+CorpusGenerator::appendWords
+===================
+*/
+void CorpusGenerator::appendWords(QByteArray &line, Random &random, int length) const
+{
+    qsizetype end = line.size() + length;
+
+    while (line.size() < end)
+    {
+        line.append(wordList[random.bounded(static_cast<int>(std::size(wordList)))]);
+        line.append(random.chance(0.1) ? ", " : " ");
+    }
+}
+
+/*
+===================
+CorpusGenerator::appendCode
+
+Literals also hold escaped quotes, backslashes and comment markers,
+which must not change the state of the line.
+===================
+*/
+void CorpusGenerator::appendCode(QByteArray &line, Random &random, const Language &language, int length) const
+{
+    qsizetype end = line.size() + length;
+    bool literal = random.chance(options.literalDensity);
+
+    while (line.size() < end)
+    {
+        line.append(wordList[random.bounded(static_cast<int>(std::size(wordList)))]);
+        line.append(operatorList[random.bounded(static_cast<int>(std::size(operatorList)))]);
+
+        if (!literal || !random.chance(0.3))
+            continue;
+
+        switch (random.bounded(4))
+        {
+        case 0:
+            line.append("\"");
+            appendWords(line, random, random.bounded(16));
+            line.append("\"");
+            break;
+        case 1:
+            line.append("\"escaped \\\" ");
+            line.append(language.singleComment[0] ? language.singleComment[0] : "//");
+            line.append(" quote\\\\\"");
+            break;
+        case 2:
+            line.append(random.chance(0.5) ? "'\\''" : "'x'");
+            break;
+        case 3:
+            line.append("\"");
+            line.append(language.multipleCommentStart[0] ? language.multipleCommentStart[0] : "/*");
+            line.append(" not a comment\"");
+            break;
+        }
+    }
+
+    // Trailing comment
+    if (language.singleComment[0] && random.chance(options.commentDensity / 2))
+    {
+        line.append(' ');
+        line.append(language.singleComment[0]);
+        line.append(' ');
+        appendWords(line, random, options.lineLength / 2);
+    }
+}
+
+/*
+===================
+CorpusGenerator::appendComment
+===================
+*/
+void CorpusGenerator::appendComment(QByteArray &text, Random &random, const Language &language) const
+{
+    int singleCount = 0, multipleCount = 0;
+
+    while (language.singleComment[singleCount])
+        singleCount++;
+
+    while (language.multipleCommentStart[multipleCount])
+        multipleCount++;
+
+    int length = options.lineLength / 2 + random.bounded(qMax(options.lineLength, 1));
+
+    // Single line comment
+    if (singleCount && (!multipleCount || random.chance(0.7)))
+    {
+        text.append(QByteArray(random.bounded(3) * 4, ' '));
+        text.append(language.singleComment[random.bounded(singleCount)]);
+        text.append(' ');
+        appendWords(text, random, length);
+        return;
+    }
+
+    if (!multipleCount)
+        return;
+
+    int k = random.bounded(multipleCount);
+    int lines = random.bounded(6);
+
+    // Ruby's =begin and =end have to be on lines of their own
+    if (language.type == Language::Ruby)
+    {
+        text.append(language.multipleCommentStart[k]);
+        text.append('\n');
+
+        for (int i = 0; i < lines; i++)
+        {
+            appendWords(text, random, length);
+            text.append('\n');
+        }
+
+        text.append(language.multipleCommentEnd[k]);
+        return;
+    }
+
+    text.append(language.multipleCommentStart[k]);
+    text.append(' ');
+
+    for (int i = 0; i < lines; i++)
+    {
+        appendWords(text, random, length);
+        text.append('\n');
+    }
+
+    appendWords(text, random, random.bounded(length));
+    text.append(language.multipleCommentEnd[k]);
+
+    // Code after the end of a comment
+    if (random.chance(0.2))
+    {
+        QByteArray code(" ");
+        appendCode(code, random, language, options.lineLength / 2);
+        text.append(code);
+    }
+}
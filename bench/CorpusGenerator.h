@@ -0,0 +1,85 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <QByteArray>
+#include <QList>
+#include "Language.h"
+
+struct CorpusOptions
+{
+    quint64 seed = 1;
+    int filesPerLanguage = 64;
+    int fileSize = 16384;           // Average, in bytes
+    int lineLength = 48;            // Average, in bytes
+    double commentDensity = 0.25;   // Share of comment lines
+    double literalDensity = 0.2;    // Share of code lines with literals
+    double blankDensity = 0.1;      // Share of blank lines
+};
+
+/*
+===========================================================
+
+    CorpusGenerator
+
+    Generates source files for the comment syntax of every
+    language: code with string and character literals, escapes
+    and comment markers inside of them, single line comments,
+    trailing comments and comment blocks spanning several lines.
+    The same options and seed always give the same files.
+
+===========================================================
+*/
+class CorpusGenerator
+{
+public:
+
+    class Random
+    {
+    public:
+
+        explicit Random(quint64 seed) : state(seed) {}
+
+        quint64 next();
+        int bounded(int bound) { return static_cast<int>(next() % static_cast<quint64>(bound)); }
+        double real() { return (next() >> 11) * (1.0 / (Q_UINT64_C(1) << 53)); }
+        bool chance(double probability) { return real() < probability; }
+
+    private:
+
+        quint64 state;
+    };
+
+    explicit CorpusGenerator(const CorpusOptions &options) : options(options) {}
+
+    QByteArray generateFile(Language::Type type, int index) const;
+    bool generate(const QString &directory, const QList<Language::Type> &types) const;
+
+private:
+
+    void appendWords(QByteArray &line, Random &random, int length) const;
+    void appendCode(QByteArray &line, Random &random, const Language &language, int length) const;
+    void appendComment(QByteArray &text, Random &random, const Language &language) const;
+
+    CorpusOptions options;
+};
+
+#endif // CORPUSGENERATOR_H
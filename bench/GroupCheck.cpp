@@ -0,0 +1,172 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <iterator>
+
+#include "Counter.h"
+#include "GroupCheck.h"
+
+/*
+===================
+GroupCheck::checkNested
+
+The outer project ignores /build and lib, which takes out the whole
+nested project under it, and the nested project's own /build only
+applies from its root. One project has a path inside another project
+and a path outside of all of them.
+===================
+*/
+void GroupCheck::checkNested()
+{
+    static const struct
+    {
+        const char *filename;
+        int lines;
+    } fileList[] = {
+        { "outer/main.cpp",                     3 },
+        { "outer/build/generated.cpp",          5 },
+        { "outer/src/util.cpp",                 7 },
+        { "outer/src/lib/lib.cpp",              11 },
+        { "outer/src/lib/build/out.cpp",        13 },
+        { "outer/src/lib/src/build/keep.cpp",   17 },
+        { "other/other.cpp",                    19 }};
+
+    static const struct
+    {
+        const char *name;
+        const char *paths[2];
+    } projectList[] = {
+        { "outer",  { "outer" } },
+        { "nested", { "outer/src/lib" } },
+        { "middle", { "outer/src" } },
+        { "other",  { "other" } },
+        { "mixed",  { "outer/src/lib/src", "other" } }};
+
+    const QStringList patterns = {"/build", "lib"};
+    const int projectCount = static_cast<int>(std::size(projectList));
+
+    QTemporaryDir temporaryDir;
+    QDir root(temporaryDir.path());
+
+    for (auto &file : fileList)
+    {
+        if (!writeFile(root.filePath(file.filename), file.lines))
+        {
+            out << "Couldn't write the nested projects.\n";
+            failures++;
+            return;
+        }
+    }
+
+    QList<QStringList> pathLists;
+
+    for (auto &project : projectList)
+    {
+        QStringList pathList;
+
+        for (auto *path : project.paths)
+            if (path)
+                pathList.append(root.filePath(path));
+
+        pathLists.append(pathList);
+    }
+
+    QList<QList<MetricsData>> expected, grouped;
+
+    for (auto &pathList : pathLists)
+    {
+        Counter counter;
+        counter.setIgnore(patterns, false);
+        counter.start(pathList);
+        counter.wait();
+
+        MetricsData data[Language::TypeCount];
+        counter.getMetrics(data);
+        expected.append(QList<MetricsData>(data, data + Language::TypeCount));
+    }
+
+    grouped.resize(projectCount);
+
+    for (auto &set : Counter::splitGroups(pathLists))
+    {
+        QList<QStringList> setPathLists;
+        QStringList pathList;
+
+        for (int group : set)
+        {
+            setPathLists.append(pathLists[group]);
+            pathList.append(pathLists[group]);
+        }
+
+        Counter counter;
+        counter.setIgnore(patterns, false);
+        counter.setGroups(setPathLists);
+        counter.start(pathList);
+        counter.wait();
+
+        for (int i = 0; i < set.size(); i++)
+        {
+            MetricsData data[Language::TypeCount];
+            counter.getGroupMetrics(i, data);
+            grouped[set[i]] = QList<MetricsData>(data, data + Language::TypeCount);
+        }
+    }
+
+    for (int i = 0; i < projectCount; i++)
+    {
+        checks++;
+
+        for (int type = 0; type < Language::TypeCount; type++)
+        {
+            const MetricsData &alone = expected[i][type];
+            const MetricsData &together = grouped[i][type];
+
+            if (alone.sourceFiles != together.sourceFiles || alone.lines != together.lines || alone.linesOfCode != together.linesOfCode ||
+                alone.commentLines != together.commentLines || alone.commentWords != together.commentWords || alone.blankLines != together.blankLines)
+            {
+                out << "Nested project " << projectList[i].name << ", " << langList[type].name << ":\n";
+                out << "    " << together.sourceFiles << " files, " << together.lines << " lines counted together, expected "
+                    << alone.sourceFiles << " files, " << alone.lines << " lines\n";
+                failures++;
+                break;
+            }
+        }
+    }
+}
+
+/*
+===================
+GroupCheck::writeFile
+===================
+*/
+bool GroupCheck::writeFile(const QString &filename, int lines) const
+{
+    if (!QDir().mkpath(QFileInfo(filename).path()))
+        return false;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    return file.write(QByteArray("// comment\nint value;\n\n").repeated(lines)) >= 0;
+}
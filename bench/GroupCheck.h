@@ -0,0 +1,59 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef GROUPCHECK_H
+#define GROUPCHECK_H
+
+#include <QTextStream>
+
+/*
+===========================================================
+
+    GroupCheck
+
+    Counts projects with paths nested in one another, each on
+    its own and all of them together in groups like counting
+    all projects does, and compares the metrics of every
+    project. Ignore patterns anchored at a project root or
+    matching the root of a nested project only come out the
+    same if every project is walked from its own paths.
+
+===========================================================
+*/
+class GroupCheck
+{
+public:
+
+    explicit GroupCheck(QTextStream &out) : out(out) {}
+
+    void checkNested();
+
+    int getChecks() const { return checks; }
+    int getFailures() const { return failures; }
+
+private:
+
+    bool writeFile(const QString &filename, int lines) const;
+
+    QTextStream &out;
+    int checks = 0;
+    int failures = 0;
+};
+
+#endif // GROUPCHECK_H
@@ -0,0 +1,306 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QFile>
+
+#include "ClassifierCheck.h"
+#include "CorpusGenerator.h"
+#include "Counter.h"
+#include "DirectoryWalker.h"
+#include "GroupCheck.h"
+#include "LineClassifier.h"
+
+struct StageResult
+{
+    QString name;
+    qint64 files = 0;
+    qint64 bytes = 0;
+    qint64 lines = 0;
+    qint64 nsecs = 0;
+};
+
+/*
+===================
+printResult
+===================
+*/
+static void printResult(QTextStream &out, const StageResult &result, bool csv)
+{
+    double seconds = qMax(result.nsecs, Q_INT64_C(1)) / 1e9;
+    double filesPerSecond = result.files / seconds;
+    double megabytesPerSecond = result.bytes / seconds / (1 << 20);
+    double linesPerSecond = result.lines / seconds;
+
+    if (csv)
+    {
+        out << QString("%1,%2,%3,%4,%5\n").arg(result.name).arg(filesPerSecond, 0, 'f', 0).arg(megabytesPerSecond, 0, 'f', 1)
+                                          .arg(linesPerSecond, 0, 'f', 0).arg(seconds * 1000, 0, 'f', 2);
+    }
+    else
+    {
+        out << QString("%1%2%3%4%5\n").arg(result.name, -16).arg(filesPerSecond, 14, 'f', 0).arg(megabytesPerSecond, 14, 'f', 1)
+                                      .arg(linesPerSecond, 14, 'f', 0).arg(seconds * 1000, 14, 'f', 2);
+    }
+}
+
+/*
+===================
+main
+
+Every stage runs a number of times and its fastest run is reported.
+Reading and classifying are measured on one thread, so their numbers
+can be compared between machines; the last stage is a whole count.
+===================
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("codemetrics-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the throughput of enumerating, reading and classifying generated source files.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("seed", "Seed of the generated files.", "number", "1"));
+    parser.addOption(QCommandLineOption("files", "Number of files per language.", "number", "64"));
+    parser.addOption(QCommandLineOption("size", "Average file size in bytes.", "bytes", "16384"));
+    parser.addOption(QCommandLineOption("line-length", "Average line length in bytes.", "bytes", "48"));
+    parser.addOption(QCommandLineOption("comments", "Share of comment lines, from 0 to 1.", "share", "0.25"));
+    parser.addOption(QCommandLineOption("literals", "Share of code lines with literals, from 0 to 1.", "share", "0.2"));
+    parser.addOption(QCommandLineOption("blanks", "Share of blank lines, from 0 to 1.", "share", "0.1"));
+    parser.addOption(QCommandLineOption("language", "Generates files only for <name>, can be repeated.", "name"));
+    parser.addOption(QCommandLineOption("dir", "Generates files into <path> and keeps them.", "path"));
+    parser.addOption(QCommandLineOption("uring", "Reads files through io_uring in the whole count, keeping <depth> files in flight per reading thread.", "depth", "0"));
+    parser.addOption(QCommandLineOption("iterations", "Number of runs of every stage.", "number", "3"));
+    parser.addOption(QCommandLineOption("per-language", "Also reports the classification of every language."));
+    parser.addOption(QCommandLineOption("csv", "Prints the results as comma-separated values."));
+    parser.addOption(QCommandLineOption("verify", "Checks the classifier against the reference classifier instead of measuring it."));
+    parser.addOption(QCommandLineOption("fuzz", "Number of random inputs per language to check with --verify.", "number", "2000"));
+    parser.addOption(QCommandLineOption("long-line", "Also checks a line longer than the mapping window with --verify, in a file of more than 512 MB."));
+    parser.process(app);
+
+    CorpusOptions options;
+    options.seed = parser.value("seed").toULongLong();
+    options.filesPerLanguage = parser.value("files").toInt();
+    options.fileSize = parser.value("size").toInt();
+    options.lineLength = parser.value("line-length").toInt();
+    options.commentDensity = parser.value("comments").toDouble();
+    options.literalDensity = parser.value("literals").toDouble();
+    options.blankDensity = parser.value("blanks").toDouble();
+
+    int iterations = qMax(parser.value("iterations").toInt(), 1);
+    int uringDepth = parser.value("uring").toInt();
+    bool csv = parser.isSet("csv");
+
+    QList<Language::Type> types;
+
+    for (int i = 0; i < Language::TypeCount; i++)
+        if (!parser.isSet("language") || parser.values("language").contains(langList[i].name, Qt::CaseInsensitive))
+            types.append(static_cast<Language::Type>(i));
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (types.isEmpty())
+    {
+        err << "No such language.\n";
+        return 1;
+    }
+
+    if (parser.isSet("verify"))
+    {
+        CorpusGenerator generator(options);
+        ClassifierCheck check(out);
+
+        check.checkCorpus(generator, types, options.filesPerLanguage);
+        check.fuzz(types, options.seed, parser.value("fuzz").toInt());
+
+        // One large file is enough, preferably of a language with multi-line comments
+        Language::Type largeType = types.first();
+
+        for (auto type : types)
+        {
+            if (langList[type].multipleCommentStart[0])
+            {
+                largeType = type;
+                break;
+            }
+        }
+
+        check.checkLargeFile(largeType, options.seed, parser.isSet("long-line"));
+
+        GroupCheck groupCheck(out);
+        groupCheck.checkNested();
+
+        out << check.getChecks() << " inputs checked, " << check.getFailures() << " mismatched.\n";
+        out << groupCheck.getChecks() << " nested projects checked, " << groupCheck.getFailures() << " mismatched.\n";
+        return (check.getFailures() || groupCheck.getFailures()) ? 1 : 0;
+    }
+
+    QTemporaryDir temporaryDir;
+    QString directory = (parser.isSet("dir") ? parser.value("dir") : temporaryDir.path());
+
+    CorpusGenerator generator(options);
+    if (!generator.generate(directory, types))
+    {
+        err << "Couldn't write files into " << directory << ".\n";
+        return 1;
+    }
+
+    QList<StageResult> results;
+    StageResult enumeration{"Enumeration"}, reading{"Reading"}, classification{"Classification"}, counting{"Count"};
+    StageResult langResults[Language::TypeCount];
+    QList<SourceFile> files;
+    QList<QByteArray> contents;
+    QElapsedTimer timer;
+
+    // Enumeration
+    for (int i = 0; i < iterations; i++)
+    {
+        std::atomic<bool> stopped = false;
+        DirectoryWalker walker(stopped);
+        QMutex mutex;
+
+        files.clear();
+        timer.start();
+
+        walker.walk(QStringList() << directory, [&files, &mutex](const SourceFile &file)
+        {
+            QMutexLocker locker(&mutex);
+            files.append(file);
+        });
+
+        qint64 nsecs = timer.nsecsElapsed();
+        enumeration.nsecs = (i ? qMin(enumeration.nsecs, nsecs) : nsecs);
+    }
+
+    enumeration.files = files.size();
+
+    // Reading
+    for (int i = 0; i < iterations; i++)
+    {
+        contents.clear();
+        reading.bytes = 0;
+        timer.start();
+
+        for (auto &file : files)
+        {
+            QFile sourceFile(file.filename);
+            if (sourceFile.open(QIODevice::ReadOnly))
+                contents.append(sourceFile.readAll());
+            else
+                contents.append(QByteArray());
+
+            reading.bytes += contents.last().size();
+        }
+
+        qint64 nsecs = timer.nsecsElapsed();
+        reading.nsecs = (i ? qMin(reading.nsecs, nsecs) : nsecs);
+    }
+
+    reading.files = files.size();
+
+    // Classification
+    for (int i = 0; i < iterations; i++)
+    {
+        qint64 langNsecs[Language::TypeCount] = {};
+        classification.lines = 0;
+        timer.start();
+
+        for (int j = 0; j < files.size(); j++)
+        {
+            qint64 start = timer.nsecsElapsed();
+
+            MetricsData data;
+            LineClassifier classifier(files[j].langType);
+            classifier.count(contents[j].constData(), contents[j].size(), data);
+
+            langNsecs[files[j].langType] += timer.nsecsElapsed() - start;
+            classification.lines += data.lines;
+
+            if (!i)
+            {
+                langResults[files[j].langType].files++;
+                langResults[files[j].langType].bytes += contents[j].size();
+                langResults[files[j].langType].lines += data.lines;
+            }
+        }
+
+        qint64 nsecs = timer.nsecsElapsed();
+        classification.nsecs = (i ? qMin(classification.nsecs, nsecs) : nsecs);
+
+        for (int j = 0; j < Language::TypeCount; j++)
+            langResults[j].nsecs = (i ? qMin(langResults[j].nsecs, langNsecs[j]) : langNsecs[j]);
+    }
+
+    classification.files = files.size();
+    classification.bytes = reading.bytes;
+
+    // Whole count on all threads
+    for (int i = 0; i < iterations; i++)
+    {
+        Counter counter;
+        counter.setUringDepth(uringDepth);
+
+        timer.start();
+        counter.start(QStringList() << directory);
+        counter.wait();
+
+        qint64 nsecs = timer.nsecsElapsed();
+        counting.nsecs = (i ? qMin(counting.nsecs, nsecs) : nsecs);
+    }
+
+    counting.files = files.size();
+    counting.bytes = reading.bytes;
+
+    // Lines are only known once the files have been classified
+    enumeration.lines = reading.lines = counting.lines = classification.lines;
+    results << enumeration << reading << classification << counting;
+
+    if (csv)
+    {
+        out << "Stage,Files/s,MB/s,Lines/s,Time (ms)\n";
+    }
+    else
+    {
+        out << QString("%1 files, %2 MB, %3 lines\n\n").arg(files.size()).arg(reading.bytes / double(1 << 20), 0, 'f', 1).arg(classification.lines);
+        out << QString("%1%2%3%4%5\n").arg("Stage", -16).arg("Files/s", 14).arg("MB/s", 14).arg("Lines/s", 14).arg("Time (ms)", 14);
+    }
+
+    for (auto &result : results)
+        printResult(out, result, csv);
+
+    if (parser.isSet("per-language"))
+    {
+        if (!csv)
+            out << "\n";
+
+        for (auto type : types)
+        {
+            langResults[type].name = langList[type].name;
+            printResult(out, langResults[type], csv);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QFile>
+#include <QTextStream>
+
+#include "ReferenceClassifier.h"
+
+/*
+===================
+ReferenceClassifier::countFile
+===================
+*/
+bool ReferenceClassifier::countFile(const QString &filename, MetricsData &data) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QTextStream in(&file);
+    count(in, data);
+    file.close();
+
+    return true;
+}
+
+/*
+===================
+ReferenceClassifier::count
+===================
+*/
+void ReferenceClassifier::count(const QByteArray &text, MetricsData &data) const
+{
+    QTextStream in(text);
+    count(in, data);
+}
+
+/*
+===================
+ReferenceClassifier::count
+===================
+*/
+void ReferenceClassifier::count(QTextStream &in, MetricsData &data) const
+{
+    cursorState cursorState = None;
+
+    // Reads a file
+    while (!in.atEnd())
+    {
+        bool isThereCommentLine = (cursorState == MultiLineComment ? true : false);
+        bool isThereCodeLine = false;
+        bool narrowLiteral = false;
+
+        QString line = in.readLine();
+        cursorState = isThereCommentLine ? MultiLineComment : None;
+
+        data.lines++;
+
+        // Blank line
+        if (line.simplified().isEmpty())
+            data.blankLines++;
+
+        // Reads a line
+        for (int j = 0; j < line.length(); j++)
+        {
+            if (cursorState == None)
+            {
+                for (int k = 0; langList[type].singleComment[k] || langList[type].multipleCommentStart[k]; k++)
+                {
+                    // Single Comment
+                    if (langList[type].singleComment[k] && checkForKeyword(line, j, langList[type].singleComment[k]))
+                    {
+                        j += strlen(langList[type].singleComment[k]);
+                        cursorState = SingleLineComment;
+                        isThereCommentLine = true;
+                        break;
+                    }
+
+                    // Multiple comment - begin
+                    if (langList[type].multipleCommentStart[k] && checkForKeyword(line, j, langList[type].multipleCommentStart[k]) && (type != Language::Ruby || (j == 0 && !line[j + strlen(langList[type].multipleCommentStart[k])].isLetterOrNumber())))
+                    {
+                        j += strlen(langList[type].multipleCommentStart[k]);
+                        cursorState = MultiLineComment;
+                        isThereCommentLine = true;
+                        break;
+                    }
+                }
+
+                if (j >= line.length()) break;
+            }
+
+            // Multiple comment - end
+            if (cursorState == MultiLineComment)
+            {
+                for (int k = 0; langList[type].multipleCommentEnd[k]; k++)
+                {
+                    if (checkForKeyword(line, j, langList[type].multipleCommentEnd[k]) && (type != Language::Ruby || (j == 0 && !line[j + strlen(langList[type].multipleCommentEnd[k])].isLetterOrNumber())))
+                    {
+                        j += strlen(langList[type].multipleCommentEnd[k]);
+                        cursorState = None;
+                        isThereCommentLine = true;
+                        break;
+                    }
+                }
+
+                if (j >= line.length()) break;
+            }
+
+            // Comment words
+            if ((cursorState == SingleLineComment || cursorState == MultiLineComment) && ((j == 0 && line[j].isLetter()) || (j > 0 && !line[j - 1].isLetter() && line[j].isLetter())))
+                data.commentWords++;
+
+            if (cursorState != SingleLineComment && cursorState != MultiLineComment)
+            {
+                // A line of code
+                if (line[j] >= '!' && line[j] <= '~') isThereCodeLine = true;
+
+                // String literal
+                if (cursorState != CharacterLiteral && !narrowLiteral && checkForKeyword(line, j, "\""))
+                    cursorState = (cursorState == StringLiteral ? None : StringLiteral);
+
+                // Character literal
+                if (cursorState != StringLiteral && !narrowLiteral && checkForKeyword(line, j, "\'"))
+                    cursorState = (cursorState == CharacterLiteral ? None : CharacterLiteral);
+
+                // Escape Character
+                if (cursorState == CharacterLiteral || cursorState == StringLiteral)
+                {
+                    if (checkForKeyword(line, j, "\\"))
+                        narrowLiteral = !narrowLiteral;
+                    else
+                        narrowLiteral = false;
+                }
+            }
+        }
+
+        if (isThereCommentLine)
+            data.commentLines++;
+
+        if (isThereCodeLine)
+            data.linesOfCode++;
+    }
+}
+
+/*
+===================
+ReferenceClassifier::checkForKeyword
+===================
+*/
+bool ReferenceClassifier::checkForKeyword(const QString &line, int index, const char *keyword)
+{
+    int len = 0;
+
+    while (keyword[len] != '\0')
+        len++;
+
+    if (len <= 0 || index < 0 || index + len > line.length())
+        return false;
+
+    for (int i = 0; i < len; i++)
+        if (line[index + i] != keyword[i])
+            return false;
+
+    return true;
+}
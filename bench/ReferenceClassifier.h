@@ -0,0 +1,55 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef REFERENCECLASSIFIER_H
+#define REFERENCECLASSIFIER_H
+
+#include "Language.h"
+
+class QTextStream;
+
+/*
+===========================================================
+
+    ReferenceClassifier
+
+    The original per-character classification of decoded lines.
+    It's slow, but it defines what the counts are, and faster
+    classifiers are checked against it.
+
+===========================================================
+*/
+class ReferenceClassifier
+{
+public:
+
+    explicit ReferenceClassifier(Language::Type type) : type(type) {}
+
+    bool countFile(const QString &filename, MetricsData &data) const;
+    void count(const QByteArray &text, MetricsData &data) const;
+    void count(QTextStream &in, MetricsData &data) const;
+
+private:
+
+    static bool checkForKeyword(const QString &line, int index, const char *keyword);
+
+    Language::Type type;
+};
+
+#endif // REFERENCECLASSIFIER_H
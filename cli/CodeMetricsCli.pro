@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Command-line counter, runs without a display server
+#
+#-------------------------------------------------
+
+QT       = core network
+
+CONFIG += c++20 console
+CONFIG -= app_bundle
+
+TARGET = codemetrics-cli
+TEMPLATE = app
+
+include(../Core.pri)
+
+SOURCES += \
+    Main.cpp \
+    Protocol.cpp \
+    Server.cpp
+
+HEADERS += \
+    Protocol.h \
+    Server.h
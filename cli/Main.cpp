@@ -0,0 +1,365 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QTextStream>
+
+#include "Counter.h"
+#include "GitRepository.h"
+#include "MetricsStore.h"
+#include "Profiler.h"
+#include "Protocol.h"
+#include "Server.h"
+
+#define NAME_WIDTH          16
+#define REVISION_WIDTH      20
+
+// How long to wait for the daemon to accept a connection, in milliseconds
+#define CONNECT_TIMEOUT     5000
+
+/*
+===================
+printMetrics
+===================
+*/
+static void printMetrics(QTextStream &out, const QString &name, const MetricsData &data, int nameWidth, bool csv)
+{
+    if (csv)
+    {
+        out << QString("%1,%2,%3,%4,%5,%6,%7\n").arg(name).arg(data.sourceFiles).arg(data.lines).arg(data.linesOfCode)
+                                                .arg(data.commentLines).arg(data.commentWords).arg(data.blankLines);
+    }
+    else
+    {
+        out << QString("%1%2%3%4%5%6%7\n").arg(name, -nameWidth).arg(data.sourceFiles, 14).arg(data.lines, 14).arg(data.linesOfCode, 14)
+                                          .arg(data.commentLines, 14).arg(data.commentWords, 14).arg(data.blankLines, 14);
+    }
+}
+
+/*
+===================
+printHeader
+===================
+*/
+static void printHeader(QTextStream &out, const QString &name, int nameWidth, bool csv)
+{
+    if (csv)
+    {
+        out << name << ",Source Files,Lines,Lines Of Code,Comment Lines,Comment Words,Blank Lines\n";
+    }
+    else
+    {
+        out << QString("%1%2%3%4%5%6%7\n").arg(name, -nameWidth).arg("Source Files", 14).arg("Lines", 14).arg("Lines Of Code", 14)
+                                          .arg("Comment Lines", 14).arg("Comment Words", 14).arg("Blank Lines", 14);
+    }
+}
+
+/*
+===================
+countHistory
+
+Counts every commit of a range and prints its totals. Blobs that
+didn't change since an earlier commit aren't read again. With a
+metrics file, each commit is also saved as a snapshot of the project
+at the time it was committed.
+===================
+*/
+static int countHistory(const QCommandLineParser &parser, const GitRepository &repository, Counter &counter, bool csv)
+{
+    QList<GitRepository::Revision> revisions;
+
+    if (!repository.history(parser.value("history"), revisions))
+    {
+        QTextStream(stderr) << "Unknown range: " << parser.value("history") << "\n";
+        return 1;
+    }
+
+    MetricsStore metricsStore;
+    QString project = parser.value("project");
+
+    if (project.isEmpty())
+        project = QFileInfo(QDir(parser.positionalArguments()[0]).absolutePath()).fileName();
+
+    if (parser.isSet("metrics"))
+        metricsStore.load(parser.value("metrics"));
+
+    QTextStream out(stdout);
+    printHeader(out, "Revision", REVISION_WIDTH, csv);
+
+    for (auto &revision : revisions)
+    {
+        counter.start(&repository, revision.treeId);
+        counter.wait();
+
+        MetricsData data[Language::TypeCount];
+        MetricsData dataTotal;
+        counter.getMetrics(data);
+
+        for (auto &languageData : data)
+            dataTotal += languageData;
+
+        QString name = QString("%1 %2").arg(QString::fromLatin1(revision.id.toHex().left(8)), QDateTime::fromMSecsSinceEpoch(revision.time).toString("yyyy-MM-dd"));
+        printMetrics(out, name, dataTotal, REVISION_WIDTH, csv);
+        out.flush();
+
+        if (parser.isSet("metrics") && !metricsStore.append(project, data, revision.time))
+        {
+            QTextStream(stderr) << "Couldn't write metrics to " << parser.value("metrics") << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+===================
+printLanguages
+===================
+*/
+static void printLanguages(QTextStream &out, const MetricsData *data, const MetricsData &dataTotal, bool csv)
+{
+    MetricsData empty;
+    printHeader(out, "Language", NAME_WIDTH, csv);
+
+    // Languages of a difference may have changed without any file being added or removed
+    for (int i = 0; i < Language::TypeCount; i++)
+    {
+        if (memcmp(&data[i], &empty, sizeof(MetricsData)))
+            printMetrics(out, langList[i].name, data[i], NAME_WIDTH, csv);
+    }
+
+    printMetrics(out, "Total", dataTotal, NAME_WIDTH, csv);
+}
+
+/*
+===================
+countRemote
+
+Sends the paths to a daemon started with --serve and prints its answer.
+===================
+*/
+static int countRemote(const QCommandLineParser &parser, const QStringList &pathList, bool csv)
+{
+    QString socketName = parser.value("socket");
+    QLocalSocket socket;
+    socket.connectToServer(socketName);
+
+    if (!socket.waitForConnected(CONNECT_TIMEOUT))
+    {
+        QTextStream(stderr) << "Couldn't connect to the daemon at " << socketName << ": " << socket.errorString() << "\n";
+        return 1;
+    }
+
+    QJsonArray paths;
+
+    for (auto &path : pathList)
+        paths.append(QFileInfo(path).absoluteFilePath());
+
+    QJsonObject request;
+    request.insert("id", 1);
+    request.insert("command", parser.isSet("diff") ? "diff" : "count");
+    request.insert("paths", paths);
+    request.insert("exclude", QJsonArray::fromStringList(parser.values("exclude")));
+    request.insert("gitignore", parser.isSet("gitignore"));
+    socket.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+
+    // Paths the daemon hasn't seen yet are counted first, which takes as long as it takes
+    while (!socket.canReadLine())
+    {
+        if (!socket.waitForReadyRead(-1))
+        {
+            QTextStream(stderr) << "The daemon closed the connection: " << socket.errorString() << "\n";
+            return 1;
+        }
+    }
+
+    QJsonObject response = QJsonDocument::fromJson(socket.readLine()).object();
+
+    if (response.contains("error"))
+    {
+        QTextStream(stderr) << response.value("error").toString() << "\n";
+        return 1;
+    }
+
+    MetricsData data[Language::TypeCount];
+    MetricsData dataTotal;
+    QTextStream out(stdout);
+
+    Protocol::fromJson(response.value("metrics").toObject(), data, dataTotal);
+    printLanguages(out, data, dataTotal, csv);
+
+    if (parser.isSet("diff"))
+    {
+        Protocol::fromJson(response.value("difference").toObject(), data, dataTotal);
+        out << "\nChanged since the last query:\n";
+        printLanguages(out, data, dataTotal, csv);
+    }
+
+    return 0;
+}
+
+/*
+===================
+main
+===================
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("codemetrics-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Counts source files, lines, lines of code, comment lines, comment words and blank lines.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("csv", "Prints the metrics as comma-separated values."));
+    parser.addOption(QCommandLineOption("cache", "Reuses per-file metrics stored in <file> for unchanged files.", "file"));
+    parser.addOption(QCommandLineOption("hash", "Hashes the contents of files whose modification time has changed to detect unchanged files."));
+    parser.addOption(QCommandLineOption("count-once", "Counts copies of a file only once: hard links, and with --compare-contents, files with the same contents."));
+    parser.addOption(QCommandLineOption("compare-contents", "Hashes files to find copies with the same contents, which are classified only once."));
+    parser.addOption(QCommandLineOption("exclude", "Skips files and directories matching <pattern>, in the syntax of .gitignore files. Can be given more than once.", "pattern"));
+    parser.addOption(QCommandLineOption("gitignore", "Skips files and directories ignored by .gitignore and .ignore files."));
+    parser.addOption(QCommandLineOption("revision", "Counts <revision> of the git repository given as the only path, reading it from the object database instead of a working tree.", "revision"));
+    parser.addOption(QCommandLineOption("history", "Counts every commit of <range>, \"<from>..<to>\" or \"<to>\", of the git repository given as the only path, following first parents.", "range"));
+    parser.addOption(QCommandLineOption("metrics", "Saves the metrics of every commit counted with --history as snapshots in <file>.", "file"));
+    parser.addOption(QCommandLineOption("project", "Project to save snapshots under, the name of the repository directory by default.", "name"));
+    parser.addOption(QCommandLineOption("uring", "Reads small files through io_uring on Linux, keeping <depth> files in flight per reading thread.", "depth"));
+    parser.addOption(QCommandLineOption("profile", "Prints the time spent in every stage of counting and writes a Chrome trace to <file>.", "file"));
+    parser.addOption(QCommandLineOption("serve", "Runs as a daemon answering queries over a local socket. Every set of paths is counted once, then watched for changes."));
+    parser.addOption(QCommandLineOption("remote", "Asks a daemon started with --serve instead of counting, with the same paths and --exclude and --gitignore options."));
+    parser.addOption(QCommandLineOption("diff", "With --remote, also prints what has changed since the daemon last answered for the same paths."));
+    parser.addOption(QCommandLineOption("socket", "Name of the local socket of the daemon, \"" DEFAULT_SOCKET_NAME "\" by default.", "name", DEFAULT_SOCKET_NAME));
+    parser.addPositionalArgument("paths", "Files and directories to count.", "<paths...>");
+    parser.process(app);
+
+    QStringList pathList = parser.positionalArguments();
+    bool csv = parser.isSet("csv");
+
+    if (parser.isSet("serve"))
+    {
+        Server server;
+
+        if (!server.listen(parser.value("socket")))
+        {
+            QTextStream(stderr) << "Couldn't listen on " << parser.value("socket") << ": " << server.errorString() << "\n";
+            return 1;
+        }
+
+        return app.exec();
+    }
+
+    if (pathList.isEmpty())
+        parser.showHelp(1);
+
+    if (parser.isSet("remote"))
+        return countRemote(parser, pathList, csv);
+
+    if (parser.isSet("profile"))
+    {
+        Profiler::setEnabled(true);
+        Profiler::reset();
+    }
+
+    FileCache fileCache;
+    GitRepository repository;
+    QByteArray treeId;
+    Counter counter;
+
+    if (parser.isSet("revision") || parser.isSet("history"))
+    {
+        if (pathList.size() != 1)
+            parser.showHelp(1);
+
+        // Revisions are read from the object database, there are no files on disk to cache or read through io_uring
+        if (parser.isSet("cache") || parser.isSet("uring"))
+        {
+            QTextStream(stderr) << "--cache and --uring can't be used with --revision or --history.\n";
+            return 1;
+        }
+
+        if (!repository.open(pathList[0]))
+        {
+            QTextStream(stderr) << "Not a git repository: " << pathList[0] << "\n";
+            return 1;
+        }
+
+        if (parser.isSet("revision") && !repository.resolve(parser.value("revision"), treeId))
+        {
+            QTextStream(stderr) << "Unknown revision: " << parser.value("revision") << "\n";
+            return 1;
+        }
+    }
+
+    if (parser.isSet("cache"))
+    {
+        fileCache.load(parser.value("cache"));
+        fileCache.setHashing(parser.isSet("hash"));
+        counter.setCache(&fileCache);
+    }
+
+    counter.setIgnore(parser.values("exclude"), parser.isSet("gitignore"));
+    counter.setDuplicates(parser.isSet("count-once") ? Counter::CountOnce : Counter::CountEveryCopy, parser.isSet("compare-contents"));
+    counter.setUringDepth(parser.value("uring").toInt());
+
+    int result = 0;
+
+    if (parser.isSet("history"))
+    {
+        result = countHistory(parser, repository, counter, csv);
+    }
+    else
+    {
+        if (parser.isSet("revision"))
+            counter.start(&repository, treeId);
+        else
+            counter.start(pathList);
+
+        counter.wait();
+
+        if (parser.isSet("cache"))
+            fileCache.save(parser.value("cache"));
+
+        MetricsData data[Language::TypeCount];
+        MetricsData dataTotal;
+        counter.getMetrics(data);
+
+        for (auto &languageData : data)
+            dataTotal += languageData;
+
+        QTextStream out(stdout);
+        printLanguages(out, data, dataTotal, csv);
+    }
+
+    if (parser.isSet("profile"))
+    {
+        QTextStream(stderr) << "\n" << Profiler::summary();
+
+        if (!Profiler::writeTrace(parser.value("profile")))
+            QTextStream(stderr) << "Couldn't write the trace to " << parser.value("profile") << "\n";
+    }
+
+    return result;
+}
@@ -0,0 +1,112 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QJsonValue>
+
+#include "Protocol.h"
+
+static const struct
+{
+    const char *name;
+    int MetricsData::*field;
+} metricList[] = {
+    { "sourceFiles",    &MetricsData::sourceFiles },
+    { "lines",          &MetricsData::lines },
+    { "linesOfCode",    &MetricsData::linesOfCode },
+    { "commentLines",   &MetricsData::commentLines },
+    { "commentWords",   &MetricsData::commentWords },
+    { "blankLines",     &MetricsData::blankLines }};
+
+/*
+===================
+toJson
+===================
+*/
+static QJsonObject toJson(const MetricsData &data)
+{
+    QJsonObject object;
+
+    for (auto &metric : metricList)
+        object.insert(metric.name, data.*metric.field);
+
+    return object;
+}
+
+/*
+===================
+fromJson
+===================
+*/
+static MetricsData fromJson(const QJsonValue &value)
+{
+    MetricsData data;
+    QJsonObject object = value.toObject();
+
+    for (auto &metric : metricList)
+        data.*metric.field = object.value(metric.name).toInt();
+
+    return data;
+}
+
+/*
+===================
+Protocol::toJson
+
+Languages without a single non-zero metric are left out.
+===================
+*/
+QJsonObject Protocol::toJson(const MetricsData *data)
+{
+    QJsonObject languages;
+    MetricsData total;
+
+    for (int i = 0; i < Language::TypeCount; i++)
+    {
+        bool empty = true;
+
+        for (auto &metric : metricList)
+            empty = empty && !(data[i].*metric.field);
+
+        if (empty)
+            continue;
+
+        languages.insert(langList[i].name, ::toJson(data[i]));
+        total += data[i];
+    }
+
+    QJsonObject object;
+    object.insert("languages", languages);
+    object.insert("total", ::toJson(total));
+    return object;
+}
+
+/*
+===================
+Protocol::fromJson
+===================
+*/
+void Protocol::fromJson(const QJsonObject &object, MetricsData *data, MetricsData &total)
+{
+    QJsonObject languages = object.value("languages").toObject();
+
+    for (int i = 0; i < Language::TypeCount; i++)
+        data[i] = ::fromJson(languages.value(langList[i].name));
+
+    total = ::fromJson(object.value("total"));
+}
@@ -0,0 +1,50 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QJsonObject>
+#include "Language.h"
+
+#define DEFAULT_SOCKET_NAME "codemetrics"
+
+/*
+===========================================================
+
+    Protocol
+
+    Requests to the daemon and its responses are JSON objects,
+    one per line. A request has a command, "count" or "diff",
+    absolute "paths", and optionally "exclude" patterns and
+    "gitignore". Its "id" is sent back with the response,
+    which holds "metrics", and for "diff" also the "difference"
+    since the last response for the same paths, or an "error".
+    "shutdown" stops the daemon. Metrics are sent per language
+    name, with a total.
+
+===========================================================
+*/
+namespace Protocol
+{
+    QJsonObject toJson(const MetricsData *data);
+    void fromJson(const QJsonObject &object, MetricsData *data, MetricsData &total);
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,331 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "Server.h"
+#include "Protocol.h"
+
+// Projects kept in memory, along with their caches and watches
+#define MAX_PROJECTS        16
+
+// Longest request line, a client sending more is dropped
+#define MAX_REQUEST_SIZE    (1 << 20)
+
+/*
+===================
+Server::Server
+===================
+*/
+Server::Server(QObject *parent) : QObject(parent)
+{
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+
+    connect(server, SIGNAL(newConnection()), SLOT(newConnection()));
+}
+
+/*
+===================
+Server::~Server
+===================
+*/
+Server::~Server()
+{
+    qDeleteAll(projects);
+}
+
+/*
+===================
+Server::listen
+
+A socket left behind by a daemon that didn't shut down cleanly is removed first.
+===================
+*/
+bool Server::listen(const QString &name)
+{
+    QLocalServer::removeServer(name);
+    return server->listen(name);
+}
+
+/*
+===================
+Server::errorString
+===================
+*/
+QString Server::errorString() const
+{
+    return server->errorString();
+}
+
+/*
+===================
+Server::newConnection
+===================
+*/
+void Server::newConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection())
+    {
+        connect(socket, SIGNAL(readyRead()), SLOT(readRequests()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+/*
+===================
+Server::readRequests
+===================
+*/
+void Server::readRequests()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+
+    while (socket->canReadLine())
+    {
+        QByteArray line = socket->readLine().trimmed();
+
+        if (line.isEmpty())
+            continue;
+
+        QJsonDocument document = QJsonDocument::fromJson(line);
+
+        if (!document.isObject())
+        {
+            sendError(socket, QJsonObject(), "Requests have to be JSON objects");
+            continue;
+        }
+
+        handleRequest(socket, document.object());
+    }
+
+    if (socket->bytesAvailable() > MAX_REQUEST_SIZE)
+        socket->abort();
+}
+
+/*
+===================
+Server::handleRequest
+
+Paths are cleaned and sorted, so the same paths given in another
+order or spelling are still the same project.
+===================
+*/
+void Server::handleRequest(QLocalSocket *socket, const QJsonObject &request)
+{
+    QString command = request.value("command").toString();
+
+    if (command == "shutdown")
+    {
+        send(socket, QJsonObject{{"id", request.value("id")}});
+        socket->flush();
+        QCoreApplication::quit();
+        return;
+    }
+
+    if (command != "count" && command != "diff")
+    {
+        sendError(socket, request, "Unknown command: " + command);
+        return;
+    }
+
+    QStringList paths;
+
+    for (auto value : request.value("paths").toArray())
+    {
+        QString path = value.toString();
+
+        // The daemon's working directory has nothing to do with the client's
+        if (QDir::isRelativePath(path))
+        {
+            sendError(socket, request, "Paths have to be absolute: " + path);
+            return;
+        }
+
+        paths.append(QDir::cleanPath(path));
+    }
+
+    if (paths.isEmpty())
+    {
+        sendError(socket, request, "No paths to count");
+        return;
+    }
+
+    QStringList patterns;
+
+    for (auto value : request.value("exclude").toArray())
+        patterns.append(value.toString());
+
+    paths.sort();
+    paths.removeDuplicates();
+
+    bool ignoreFiles = request.value("gitignore").toBool();
+    QString key = paths.join('\n') + '\0' + patterns.join('\n') + '\0' + (ignoreFiles ? '1' : '0');
+    Project *project = projects.value(key);
+
+    if (!project)
+    {
+        project = addProject(paths, patterns, ignoreFiles);
+        projects.insert(key, project);
+    }
+
+    project->lastUsed = ++queries;
+
+    if (project->counting)
+        project->waiting.append(PendingRequest{socket, request});
+    else
+        answer(socket, request, *project);
+}
+
+/*
+===================
+Server::answer
+
+Changes the watcher has seen so far are taken in first.
+===================
+*/
+void Server::answer(QLocalSocket *socket, const QJsonObject &request, Project &project)
+{
+    project.watcher.takeDifference(project.current);
+
+    QJsonObject response;
+    response.insert("id", request.value("id"));
+    response.insert("metrics", Protocol::toJson(project.current));
+
+    if (request.value("command").toString() == "diff")
+    {
+        MetricsData difference[Language::TypeCount];
+
+        for (int i = 0; i < Language::TypeCount; i++)
+        {
+            difference[i] = project.current[i];
+            difference[i] -= project.answered[i];
+        }
+
+        response.insert("difference", Protocol::toJson(difference));
+    }
+
+    memcpy(project.answered, project.current, sizeof(MetricsData) * Language::TypeCount);
+    send(socket, response);
+}
+
+/*
+===================
+Server::addProject
+===================
+*/
+Server::Project *Server::addProject(const QStringList &paths, const QStringList &patterns, bool ignoreFiles)
+{
+    if (projects.size() >= MAX_PROJECTS)
+        dropProject();
+
+    Project *project = new Project;
+    project->paths = paths;
+    project->patterns = patterns;
+    project->ignoreFiles = ignoreFiles;
+    project->counting = true;
+
+    connect(&project->counter, SIGNAL(finished()), SLOT(countFinished()));
+
+    project->counter.setCache(&project->cache);
+    project->counter.setIgnore(patterns, ignoreFiles);
+    project->counter.start(paths);
+
+    return project;
+}
+
+/*
+===================
+Server::dropProject
+
+Drops the project that was queried least recently, unless it's still being counted.
+===================
+*/
+void Server::dropProject()
+{
+    auto oldest = projects.end();
+
+    for (auto it = projects.begin(); it != projects.end(); ++it)
+    {
+        if (!(*it)->counting && (oldest == projects.end() || (*it)->lastUsed < (*oldest)->lastUsed))
+            oldest = it;
+    }
+
+    if (oldest == projects.end())
+        return;
+
+    delete *oldest;
+    projects.erase(oldest);
+}
+
+/*
+===================
+Server::countFinished
+
+A project starts being watched once it has been counted in full.
+===================
+*/
+void Server::countFinished()
+{
+    for (auto project : projects)
+    {
+        if (&project->counter != sender())
+            continue;
+
+        project->counter.wait();
+        project->counter.getMetrics(project->current);
+        memcpy(project->answered, project->current, sizeof(MetricsData) * Language::TypeCount);
+        project->counting = false;
+        project->watcher.start(project->paths, &project->cache, project->patterns, project->ignoreFiles);
+
+        for (auto &pending : project->waiting)
+        {
+            if (pending.socket)
+                answer(pending.socket, pending.request, *project);
+        }
+
+        project->waiting.clear();
+        return;
+    }
+}
+
+/*
+===================
+Server::sendError
+===================
+*/
+void Server::sendError(QLocalSocket *socket, const QJsonObject &request, const QString &error)
+{
+    send(socket, QJsonObject{{"id", request.value("id")}, {"error", error}});
+}
+
+/*
+===================
+Server::send
+===================
+*/
+void Server::send(QLocalSocket *socket, const QJsonObject &response)
+{
+    socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact) + '\n');
+}
@@ -0,0 +1,105 @@
+/*
+===============================================================================
+    Copyright (C) 2015-2021 Ilya Lyakhovets
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+===============================================================================
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include "Counter.h"
+#include "Watcher.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+/*
+===========================================================
+
+    Server
+
+    Answers count queries over a local socket. Every distinct
+    set of paths and ignore settings is a project, counted in
+    full once, with its own file cache. After that its paths
+    are watched, so the metrics stay current and a query is
+    answered right away. Projects that haven't been queried
+    for the longest are dropped when there are too many.
+
+===========================================================
+*/
+class Server : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    explicit Server(QObject *parent = nullptr);
+    ~Server();
+
+    bool listen(const QString &name);
+    QString errorString() const;
+
+private Q_SLOTS:
+
+    void newConnection();
+    void readRequests();
+    void countFinished();
+
+private:
+
+    struct PendingRequest
+    {
+        QPointer<QLocalSocket> socket;
+        QJsonObject request;
+    };
+
+    struct Project
+    {
+        QStringList paths;
+        QStringList patterns;
+        bool ignoreFiles = false;
+
+        // The watcher uses the cache, so it's destroyed first
+        FileCache cache;
+        Counter counter;
+        Watcher watcher;
+
+        bool counting = false;
+        quint64 lastUsed = 0;
+        MetricsData current[Language::TypeCount];
+        MetricsData answered[Language::TypeCount];  // Sent with the last response, for diffs
+        QList<PendingRequest> waiting;              // Wait for the project to be counted
+    };
+
+    void handleRequest(QLocalSocket *socket, const QJsonObject &request);
+    void answer(QLocalSocket *socket, const QJsonObject &request, Project &project);
+    Project *addProject(const QStringList &paths, const QStringList &patterns, bool ignoreFiles);
+    void dropProject();
+
+    static void sendError(QLocalSocket *socket, const QJsonObject &request, const QString &error);
+    static void send(QLocalSocket *socket, const QJsonObject &response);
+
+    QLocalServer *server;
+    QHash<QString, Project *> projects;
+    quint64 queries = 0;
+};
+
+#endif // SERVER_H